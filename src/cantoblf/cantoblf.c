@@ -0,0 +1,255 @@
+/*  cantoblf -- convert CAN log files to BLF files
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "measurement.h"
+#include "canreader.h"
+#include "blfwriter.h"
+
+int verbose_flag = 0;
+int debug_flag   = 0;
+
+const char *program_name;
+
+/* messages per reader batch */
+#define CANTOBLF_BATCH_SIZE 1024
+
+/* conversion state */
+typedef struct {
+  blfWriter_t *writer;
+  int          bus;      /* bus to keep, -1 for all */
+  unsigned long nMessages;
+} cantoblf_t;
+
+static void usage_error(void)
+{
+  fprintf(stderr, "Type '%s --help' for more information\n",program_name);
+  exit(1);
+}
+
+static void
+help(void)
+{
+  fprintf(stderr,
+          "Usage: %s [OPTION] -o blffile\n"
+          "cantoblf " VERSION ": Convert CAN trace file to BLF file.\n"
+          "\n"
+          "Options:\n"
+          "  -a, --asc <ascfile>        ASC input file\n"
+          "  -B, --blf <blffile>        BLF input file\n"
+          "  -c, --clg <clgfile>        CLG input file\n"
+          "  -v, --vsb <vsbfile>        VSB input file\n"
+          "  -i, --input <file>         input file, the format is determined\n"
+          "                             from its contents\n"
+          "  -o, --output <blffile>     BLF output file\n"
+          "  -b, --bus <busid>          write only messages of bus <busid>\n"
+          "  -l, --level <level>        compression level 0..9, 0 stores\n"
+          "                             containers uncompressed (default: %d)\n"
+          "  -s, --container-size <n>   uncompressed container size in bytes\n"
+          "                             (default: %u)\n"
+          "  -j, --threads <n>          number of ASC and BLF reader threads\n"
+          "                             (default: number of CPUs)\n"
+          "      --verbose              verbose output\n"
+          "      --brief                brief output (default)\n"
+          "      --debug                output debug information\n"
+          "      --help                 display this help and exit\n",
+          program_name,
+          BLF_WRITER_DEFAULT_LEVEL,
+          BLF_WRITER_DEFAULT_CONTAINER_SIZE);
+}
+
+/* write batch of messages */
+static void
+cantoblf_writeBatch(cantoblf_t *conv, canMessage_t *message, unsigned int n)
+{
+  unsigned int i;
+
+  for(i = 0; i < n; i++) {
+    if((conv->bus != -1) && (message[i].bus != conv->bus)) continue;
+    if(blfWriterWriteCANMessage(conv->writer, &message[i])) {
+      conv->nMessages++;
+    }
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  char *inputFilename = NULL;
+  int inputFiles = 0;
+  char *blfFilename = NULL;
+  int level = BLF_WRITER_DEFAULT_LEVEL;
+  unsigned long containerSize = BLF_WRITER_DEFAULT_CONTAINER_SIZE;
+  const canReaderFormat_t *format = NULL;
+  cantoblf_t conv = { NULL, -1, 0 };
+  canReader_t *reader;
+  canMessage_t *message;
+  unsigned int n;
+
+  program_name = argv[0];
+
+  /* parse arguments */
+  while (1) {
+    static struct option long_options[] = {
+      /* These options set a flag. */
+      {"verbose", no_argument,       &verbose_flag, 1},
+      {"brief",   no_argument,       &verbose_flag, 0},
+      {"debug",   no_argument,       &debug_flag,   1},
+      /* These options don't set a flag.
+         We distinguish them by their indices. */
+      {"asc",     required_argument, 0, 'a'},
+      {"blf",     required_argument, 0, 'B'},
+      {"bus",     required_argument, 0, 'b'},
+      {"clg",     required_argument, 0, 'c'},
+      {"input",   required_argument, 0, 'i'},
+      {"level",   required_argument, 0, 'l'},
+      {"output",  required_argument, 0, 'o'},
+      {"container-size", required_argument, 0, 's'},
+      {"threads", required_argument, 0, 'j'},
+      {"vsb",     required_argument, 0, 'v'},
+      {"help",    no_argument,    NULL, 'h'},
+      {0, 0, 0, 0}
+    };
+
+    /* getopt_long stores the option index here. */
+    int option_index = 0;
+    int c;
+
+    c = getopt_long (argc, argv, "a:B:b:c:i:j:l:o:s:v:",
+                     long_options, &option_index);
+
+    /* Detect the end of the options. */
+    if (c == -1) break;
+
+    switch (c) {
+    case 0:
+      break;
+    case 'a':
+      inputFilename = optarg;
+      format = canReader_format("ASC");
+      inputFiles++;
+      break;
+    case 'B':
+      inputFilename = optarg;
+      format = canReader_format("BLF");
+      inputFiles++;
+      break;
+    case 'c':
+      inputFilename = optarg;
+      format = canReader_format("CLG");
+      inputFiles++;
+      break;
+    case 'v':
+      inputFilename = optarg;
+      format = canReader_format("VSB");
+      inputFiles++;
+      break;
+    case 'i':
+      inputFilename = optarg;
+      format = NULL;
+      inputFiles++;
+      break;
+    case 'b':
+      conv.bus = atoi(optarg);
+      break;
+    case 'l':
+      level = atoi(optarg);
+      break;
+    case 'o':
+      blfFilename = optarg;
+      break;
+    case 's':
+      containerSize = strtoul(optarg, NULL, 10);
+      break;
+    case 'j':
+      canReader_setThreads((unsigned int)atoi(optarg));
+      break;
+    case 'h': help(); exit(0);   break;
+    case '?':
+      /* getopt_long already printed an error message. */
+      usage_error();
+      break;
+    default:
+      fprintf(stderr, "error: unknown option %c\n", c);
+      usage_error();
+    }
+  }
+
+  /* diagnose options */
+  if(inputFiles != 1) {
+    fprintf(stderr, "error: please specify exactly one input file\n");
+    usage_error();
+  }
+  if(blfFilename == NULL) {
+    fprintf(stderr, "error: BLF output filename not specified\n");
+    usage_error();
+  }
+  if((containerSize == 0) || (containerSize > UINT32_MAX)) {
+    fprintf(stderr, "error: invalid container size\n");
+    usage_error();
+  }
+
+  /* determine input format from the file contents */
+  if(format == NULL) {
+    format = canReader_detect(inputFilename);
+    if(format == NULL) {
+      fprintf(stderr, "error: can't determine format of %s, "
+              "use -a, -B, -c or -v for pipes\n",
+              inputFilename);
+      return 1;
+    }
+  }
+
+  /* open input file */
+  reader = canReader_open(inputFilename, format);
+  if(reader == NULL) {
+    fprintf(stderr, "error: can't open input file %s\n", inputFilename);
+    return 1;
+  }
+
+  conv.writer = blfWriterCreate(blfFilename, level, (uint32_t)containerSize);
+  message = malloc(CANTOBLF_BATCH_SIZE * sizeof(*message));
+  if((conv.writer == NULL) || (message == NULL)) {
+    canReader_close(reader);
+    free(message);
+    blfWriterClose(conv.writer);
+    return 1;
+  }
+
+  if(verbose_flag) {
+    fprintf(stderr, "Converting %s file %s to %s\n",
+            format->name, inputFilename, blfFilename);
+  }
+  while((n = canReader_nextBatch(reader, message, CANTOBLF_BATCH_SIZE)) > 0) {
+    cantoblf_writeBatch(&conv, message, n);
+  }
+  canReader_close(reader);
+  free(message);
+
+  if(!blfWriterClose(conv.writer)) {
+    fprintf(stderr, "error: writing %s failed\n", blfFilename);
+    return 1;
+  }
+  if(verbose_flag) {
+    fprintf(stderr, "%lu messages written\n", conv.nMessages);
+  }
+  return 0;
+}
@@ -19,15 +19,45 @@
 #include <stdio.h>
 #include <string.h>
 #include "busassignment.h"
+#include "messagedecoder.h"
+#include "hashtable.h"
 
 extern int verbose_flag;
 
+/* simple string hash function for signal names */
+static unsigned int signalName_computeHash( void *k)
+{
+  unsigned int hash = 0;
+  int c;
+
+  while ((c = *(unsigned char *)k++)) {
+    hash = c + (hash << 6) + (hash << 16) - hash;
+  }
+
+  return hash;
+}
+
+/* string comparison function for signal names */
+static int signalNames_equal ( void *key1, void *key2 )
+{
+  return strcmp((char *)key1, (char *)key2) == 0;
+}
+
 busAssignment_t *busAssignment_create(void)
 {
   CREATE(busAssignment_t, busAssignment);
+  int i;
 
   busAssignment->n = 0;
   busAssignment->list = NULL;
+  for(i = 0; i < BUSASSIGNMENT_MAX_BUS; i++) {
+    busAssignment->dispatch[i] = NULL;
+  }
+  busAssignment->signalNameHash = NULL;
+  busAssignment->nSignalNames = 0;
+  busAssignment->signalNames = NULL;
+  busAssignment->signalTimeColumn = NULL;
+  busAssignment->nTimeColumns = 0;
   return busAssignment;
 }
 
@@ -44,11 +74,166 @@ void busAssignment_associate(busAssignment_t *busAssignment,
   busAssignment->list[busAssignment->n-1].messageHash = NULL;
 }
 
-int busAssignment_parseDBC(busAssignment_t *busAssignment)
+/*
+ * intern output signal name and return its time series slot
+ *
+ * The name is consumed: it is either stored in the name table or
+ * freed, if an equal name has already been interned.
+ *
+ * A slot shares the time column of the message producing it. If a
+ * second producer is bound to the same slot, the slot falls back to
+ * private time stamps.
+ */
+static int busAssignment_internName(busAssignment_t *busAssignment,
+                                    char *name, unsigned int timeColumn,
+                                    unsigned int *slotPtr)
+{
+  unsigned int *slot = hashtable_search(busAssignment->signalNameHash, name);
+
+  if(slot != NULL) {
+    free(name);
+    busAssignment->signalTimeColumn[*slot] = BUSASSIGNMENT_PRIVATE_TIME;
+  } else {
+    unsigned int *columns;
+    char **names = realloc(busAssignment->signalNames,
+                           (busAssignment->nSignalNames + 1)
+                           * sizeof(*names));
+    if(names == NULL) goto fail;
+    busAssignment->signalNames = names;
+
+    columns = realloc(busAssignment->signalTimeColumn,
+                      (busAssignment->nSignalNames + 1)
+                      * sizeof(*columns));
+    if(columns == NULL) goto fail;
+    busAssignment->signalTimeColumn = columns;
+    columns[busAssignment->nSignalNames] = timeColumn;
+
+    slot = malloc(sizeof(*slot));
+    if(slot == NULL) goto fail;
+    *slot = busAssignment->nSignalNames;
+    if(!hashtable_insert(busAssignment->signalNameHash, name, slot)) {
+      free(slot);
+      goto fail;
+    }
+    names[busAssignment->nSignalNames++] = name;
+  }
+  *slotPtr = *slot;
+  return 0;
+
+fail:
+  free(name);
+  return 1;
+}
+
+/*
+ * resolve output signal names of a signal group, all signals of the
+ * group share one time column
+ */
+static int busAssignment_bindGroup(busAssignment_t *busAssignment,
+                                   signalGroup_t *group,
+                                   const char *local_prefix)
+{
+  unsigned int i;
+
+  group->timeColumn = busAssignment->nTimeColumns++;
+
+  for(i = 0; i < group->nSignals; i++) {
+    signalLayout_t *sl = &group->signals[i];
+    char *outputSignalName =
+      signalFormat_stringAppend(local_prefix, sl->signal->name);
+
+    if(   (outputSignalName == NULL)
+       || busAssignment_internName(busAssignment, outputSignalName,
+                                   group->timeColumn, &sl->slot)) {
+      fprintf(stderr,
+              "busAssignment_bindSignals(): can't allocate signal name\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * resolve output signal names of all messages of a bus assignment
+ * entry and store the time series slot in the signal layouts
+ */
+static int busAssignment_bindSignals(busAssignment_t *busAssignment,
+                                     busAssignmentEntry_t *entry,
+                                     signalFormat_t signalFormat)
+{
+  unsigned int k;
+  int ret = 0;
+
+  for(k = 0; (ret == 0) && (k < entry->messageHash->nLayouts); k++) {
+    messageLayout_t *layout = entry->messageHash->layouts[k];
+    char *local_prefix = NULL;
+    unsigned int i;
+
+    /* setup message prefix */
+    if(signalFormat & signalFormat_Message) {
+      local_prefix = signalFormat_stringAppend(NULL, layout->message->name);
+    }
+
+    /* signals present in every frame, then each multiplexed group */
+    ret = busAssignment_bindGroup(busAssignment, &layout->base,
+                                  local_prefix);
+    for(i = 0; (ret == 0) && (i < layout->nGroups); i++) {
+      ret = busAssignment_bindGroup(busAssignment, &layout->groups[i],
+                                    local_prefix);
+    }
+
+    /* free local prefix */
+    if(local_prefix != NULL) free(local_prefix);
+  }
+
+  return ret;
+}
+
+/*
+ * mark layouts whose output signals are not produced by any other
+ * layout, their frames can be decoded out of file order
+ */
+static void busAssignment_markExclusive(busAssignment_t *busAssignment)
+{
+  int i;
+
+  for(i = 0; i < busAssignment->n; i++) {
+    messageHash_t *messageHash = busAssignment->list[i].messageHash;
+    unsigned int k, j;
+
+    for(k = 0; k < messageHash->nLayouts; k++) {
+      messageLayout_t *layout = messageHash->layouts[k];
+
+      layout->exclusive = 1;
+      for(j = 0; j < layout->nSignals; j++) {
+        unsigned int slot = layout->signals[j].slot;
+
+        if(busAssignment->signalTimeColumn[slot]
+           == BUSASSIGNMENT_PRIVATE_TIME) {
+          layout->exclusive = 0;
+        }
+      }
+    }
+  }
+}
+
+int busAssignment_parseDBC(busAssignment_t *busAssignment,
+                           signalFormat_t signalFormat)
 {
   int i;
   int ret = 0;
 
+  /* create output signal name table */
+  busAssignment->signalNameHash = create_hashtable(
+      16,
+      signalName_computeHash,
+      signalNames_equal);
+  if(busAssignment->signalNameHash == NULL) {
+    fprintf(stderr,
+            "busAssignment_parseDBC(): can't create signal name hash table\n");
+    return 1;
+  }
+
   for(i = 0; i < busAssignment->n; i++) {
     dbc_t *dbc;
 
@@ -68,6 +253,14 @@ int busAssignment_parseDBC(busAssignment_t *busAssignment)
         break;
       }
       dbc_free(dbc);
+
+      /* resolve output signal names once */
+      if(busAssignment_bindSignals(busAssignment,
+                                   &busAssignment->list[i],
+                                   signalFormat)) {
+        ret = 1;
+        break;
+      }
     } else {
       fprintf(stderr, "busAssignment_parseDBC(): error opening DBC file %s\n",
               busAssignment->list[i].filename);
@@ -75,20 +268,127 @@ int busAssignment_parseDBC(busAssignment_t *busAssignment)
       break;
     }
   }
+  if(ret == 0) busAssignment_markExclusive(busAssignment);
   return ret;
 }
 
+/*
+ * search the bus assignment entries in command line order, the first
+ * entry of the bus defining the id wins
+ */
+static messageLayout_t *busAssignment_search(busAssignment_t *busAssignment,
+                                             uint8 bus, uint32 id)
+{
+  int i;
+
+  for(i = 0; i < busAssignment->n; i++) {
+    busAssignmentEntry_t *entry = &busAssignment->list[i];
+
+    if((entry->bus == -1) || (entry->bus == bus)) {
+      messageLayout_t *layout = messageHash_search(entry->messageHash, id);
+
+      if(layout != NULL) return layout;
+    }
+  }
+  return NULL;
+}
+
+/* double the identifier cache of a bus and rehash its slots */
+static int busDispatch_grow(busDispatch_t *dispatch)
+{
+  unsigned int bits = (dispatch->ext == NULL) ? 6 : (33 - dispatch->shift);
+  busDispatchSlot_t *ext = calloc((size_t)1 << bits, sizeof(*ext));
+  unsigned int i;
+
+  if(ext == NULL) return 1;
+  if(dispatch->ext != NULL) {
+    for(i = 0; i <= dispatch->mask; i++) {
+      const busDispatchSlot_t *slot = &dispatch->ext[i];
+      unsigned int k;
+
+      if(!slot->used) continue;
+      k = (uint32)(slot->id * 0x9E3779B1UL) >> (32 - bits);
+      while(ext[k].used) k = (k + 1) & ((1u << bits) - 1);
+      ext[k] = *slot;
+    }
+    free(dispatch->ext);
+  }
+  dispatch->ext = ext;
+  dispatch->shift = 32 - bits;
+  dispatch->mask = (1u << bits) - 1;
+  return 0;
+}
+
+/*
+ * resolve an identifier which is not yet in the dispatch table of
+ * its bus, and add it to the table
+ */
+messageLayout_t *busAssignment_resolve(busAssignment_t *busAssignment,
+                                       uint8 bus, uint32 id)
+{
+  busDispatch_t *dispatch = busAssignment->dispatch[bus];
+  messageLayout_t *layout;
+  unsigned int i;
+
+  if(dispatch == NULL) {
+    dispatch = malloc(sizeof(*dispatch));
+    if(dispatch == NULL) goto fail;
+    for(i = 0; i <= MESSAGEHASH_MASK_11; i++) {
+      dispatch->std[i] = busAssignment_search(busAssignment, bus, i);
+    }
+    dispatch->shift = 0;
+    dispatch->mask = 0;
+    dispatch->nExt = 0;
+    dispatch->ext = NULL;
+    busAssignment->dispatch[bus] = dispatch;
+  }
+  if(id <= MESSAGEHASH_MASK_11) return dispatch->std[id];
+
+  /* keep the cache at most half full */
+  layout = busAssignment_search(busAssignment, bus, id);
+  if(   (   (dispatch->ext == NULL)
+         || (2 * (dispatch->nExt + 1) > dispatch->mask))
+     && busDispatch_grow(dispatch)) {
+    goto fail;
+  }
+  i = (uint32)(id * 0x9E3779B1UL) >> dispatch->shift;
+  while(dispatch->ext[i].used) i = (i + 1) & dispatch->mask;
+  dispatch->ext[i].id = id;
+  dispatch->ext[i].used = 1;
+  dispatch->ext[i].layout = layout;
+  dispatch->nExt++;
+  return layout;
+
+fail:
+  /* answer without caching */
+  fprintf(stderr, "busAssignment_resolve(): out of memory\n");
+  return busAssignment_search(busAssignment, bus, id);
+}
+
 void busAssignment_free(busAssignment_t *busAssignment)
 {
   int i;
 
   if(busAssignment != NULL) {
+    for(i = 0; i < BUSASSIGNMENT_MAX_BUS; i++) {
+      if(busAssignment->dispatch[i] != NULL) {
+        free(busAssignment->dispatch[i]->ext);
+        free(busAssignment->dispatch[i]);
+      }
+    }
     for(i = 0; i < busAssignment->n; i++) {
       busAssignmentEntry_t *entry = &(busAssignment->list[i]);
       free(entry->filename);
       messageHash_free(entry->messageHash);
     }
     if(busAssignment->list != NULL) free(busAssignment->list);
+
+    /* signal names are owned by the name hash */
+    if(busAssignment->signalNameHash != NULL) {
+      hashtable_destroy(busAssignment->signalNameHash, 1);
+    }
+    free(busAssignment->signalNames);
+    free(busAssignment->signalTimeColumn);
   }
   free(busAssignment);
 }
@@ -19,7 +19,9 @@
 
 #include "cantools_config.h"
 
+#include "hashtable.h"
 #include "messagehash.h"
+#include "signalformat.h"
 
 typedef struct {
   int bus;
@@ -27,15 +29,79 @@ typedef struct {
   messageHash_t *messageHash;
 } busAssignmentEntry_t;
 
+/* time column index of signals which need their own time stamps */
+#define BUSASSIGNMENT_PRIVATE_TIME (~0u)
+
+/* number of CAN busses addressable by canMessage_t */
+#define BUSASSIGNMENT_MAX_BUS 256
+
+/* cached lookup result of an identifier, empty if used is 0 */
+typedef struct {
+  uint32                  id;
+  uint32                  used;
+  struct messageLayout_s *layout; /* NULL: no DBC defines the id */
+} busDispatchSlot_t;
+
+/*
+ * dispatch table of one bus, built on the first frame of the bus
+ *
+ * 11 bit identifiers are resolved for all bus assignment entries at
+ * once. Other identifiers are resolved on first sight and cached,
+ * including identifiers which no DBC file defines.
+ */
+typedef struct {
+  struct messageLayout_s *std[MESSAGEHASH_MASK_11 + 1];
+  unsigned int       shift;  /* 32 - log2(number of slots) */
+  unsigned int       mask;   /* number of slots - 1 */
+  unsigned int       nExt;   /* used slots */
+  busDispatchSlot_t *ext;    /* open addressing cache, NULL if empty */
+} busDispatch_t;
+
 typedef struct {
   int n;
   busAssignmentEntry_t *list; /* array of n busAssigmentEntry_t's */
+  busDispatch_t *dispatch[BUSASSIGNMENT_MAX_BUS]; /* NULL until used */
+  struct hashtable *signalNameHash; /* output signal name -> slot */
+  unsigned int nSignalNames;
+  char **signalNames;         /* output signal names, indexed by slot */
+  unsigned int *signalTimeColumn; /* shared time column, indexed by slot */
+  unsigned int nTimeColumns;  /* number of shared time columns */
 } busAssignment_t;
 
 busAssignment_t *busAssignment_create(void);
 void busAssignment_associate(busAssignment_t *busAssigment,
                              int bus, char *filename);
 void busAssignment_free(busAssignment_t *busAssigment);
-int busAssignment_parseDBC(busAssignment_t *busAssignment);
+int busAssignment_parseDBC(busAssignment_t *busAssignment,
+                           signalFormat_t signalFormat);
+struct messageLayout_s *busAssignment_resolve(busAssignment_t *busAssignment,
+                                              uint8 bus, uint32 id);
+
+/*
+ * look up compiled message layout of a received frame
+ *
+ * returns NULL, if no DBC file assigned to the bus defines the id
+ */
+static inline struct messageLayout_s *
+busAssignment_lookup(busAssignment_t *busAssignment, uint8 bus, uint32 id)
+{
+  const busDispatch_t *dispatch = busAssignment->dispatch[bus];
+
+  if(dispatch != NULL) {
+    if(id <= MESSAGEHASH_MASK_11) return dispatch->std[id];
+    if(dispatch->ext != NULL) {
+      unsigned int i;
+
+      for(i = (uint32)(id * 0x9E3779B1UL) >> dispatch->shift; ;
+          i = (i + 1) & dispatch->mask) {
+        const busDispatchSlot_t *slot = &dispatch->ext[i];
+
+        if(!slot->used) break;
+        if(slot->id == id) return slot->layout;
+      }
+    }
+  }
+  return busAssignment_resolve(busAssignment, bus, id);
+}
 
 #endif
@@ -0,0 +1,319 @@
+/*  canreader.c -- registry of CAN trace file readers
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "canreader.h"
+#include "ascreader.h"
+#include "blfreader.h"
+#include "blfapi.h"
+#include "clgreader.h"
+#include "vsbreader.h"
+
+struct canReader_s {
+  const canReaderFormat_t *format;
+  void     *reader;    /* reader of the format */
+  int       seeking;   /* skip messages before seekTime */
+  uint64_t  seekTime;
+  uint64_t  lastTime;  /* time stamp of last delivered message */
+};
+
+/* nextBatch and close hooks of the pull-based reader of a format */
+#define CANREADER_HOOKS(prefix, type)                                   \
+  static unsigned int prefix##_nextBatchHook(void *reader,              \
+                                             canMessage_t *message,     \
+                                             unsigned int size)         \
+  {                                                                     \
+    return prefix##_nextBatch((type *)reader, message, size);           \
+  }                                                                     \
+  static void prefix##_closeHook(void *reader)                          \
+  {                                                                     \
+    prefix##_close((type *)reader);                                     \
+  }
+
+CANREADER_HOOKS(ascReader, ascReader_t)
+CANREADER_HOOKS(blfReader, blfReader_t)
+CANREADER_HOOKS(clgReader, clgReader_t)
+CANREADER_HOOKS(vsbReader, vsbReader_t)
+
+static void *ascReader_openHook(FILE *fp, const char *path)
+{
+  (void)path;
+  return ascReader_open(fp);
+}
+
+static void *blfReader_openHook(FILE *fp, const char *path)
+{
+  return blfReader_open(fp, path);
+}
+
+static void *clgReader_openHook(FILE *fp, const char *path)
+{
+  (void)path;
+  return clgReader_open(fp);
+}
+
+static void *vsbReader_openHook(FILE *fp, const char *path)
+{
+  (void)path;
+  return vsbReader_open(fp);
+}
+
+static int blfReader_seekTimeHook(void *reader, uint64_t t)
+{
+  return blfReader_seekTime((blfReader_t *)reader, t);
+}
+
+/*
+ * known formats, probed in this order: formats with a binary signature
+ * first, the ASC header keywords last
+ */
+static const canReaderFormat_t canReader_formats[] = {
+  { "BLF",
+    CANREADER_CAP_SEEKABLE | CANREADER_CAP_BATCHABLE | CANREADER_CAP_PARALLEL,
+    blfReader_probe, blfReader_processFileBatch,
+    blfSetThreads, blfReader_processFileRange,
+    blfReader_openHook, blfReader_nextBatchHook,
+    blfReader_seekTimeHook, blfReader_closeHook },
+  { "VSB",
+    CANREADER_CAP_BATCHABLE,
+    vsbReader_probe, vsbReader_processFileBatch,
+    NULL, NULL,
+    vsbReader_openHook, vsbReader_nextBatchHook,
+    NULL, vsbReader_closeHook },
+  { "CLG",
+    CANREADER_CAP_BATCHABLE,
+    clgReader_probe, clgReader_processFileBatch,
+    NULL, NULL,
+    clgReader_openHook, clgReader_nextBatchHook,
+    NULL, clgReader_closeHook },
+  { "ASC",
+    CANREADER_CAP_BATCHABLE | CANREADER_CAP_PARALLEL,
+    ascReader_probe, ascReader_processFileBatch,
+    ascReader_setThreads, NULL,
+    ascReader_openHook, ascReader_nextBatchHook,
+    NULL, ascReader_closeHook },
+};
+
+#define CANREADER_NFORMATS \
+  (sizeof(canReader_formats) / sizeof(canReader_formats[0]))
+
+/*
+ * look up format by name, e.g. "BLF"
+ *
+ * returns NULL for unknown names
+ */
+const canReaderFormat_t *canReader_format(const char *name)
+{
+  size_t i;
+
+  for(i = 0; i < CANREADER_NFORMATS; i++) {
+    if(!strcmp(canReader_formats[i].name, name)) {
+      return &canReader_formats[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * determine format of an open file from its leading bytes, fp is
+ * positioned at the start again
+ *
+ * Only regular files are probed: the bytes read from a pipe would be
+ * lost for the reader.
+ *
+ * returns NULL if the file can't be probed or the format is unknown
+ */
+static const canReaderFormat_t *canReader_detectFile(FILE *fp,
+                                                     const char *name)
+{
+  unsigned char head[CANREADER_PROBE_SIZE];
+  struct stat st;
+  long pos;
+  size_t n, i;
+
+  if(   (fstat(fileno(fp), &st) != 0) || !S_ISREG(st.st_mode)
+     || ((pos = ftell(fp)) == -1)) {
+    fprintf(stderr, "canReader_detect(): can't determine format of %s, "
+            "it is not a regular file\n", name);
+    return NULL;
+  }
+  n = fread(head, 1, sizeof(head), fp);
+  if(0 != fseek(fp, pos, SEEK_SET)) {
+    fprintf(stderr, "canReader_detect(): can't rewind %s\n", name);
+    return NULL;
+  }
+
+  for(i = 0; i < CANREADER_NFORMATS; i++) {
+    if(canReader_formats[i].probe(head, n)) return &canReader_formats[i];
+  }
+  fprintf(stderr, "canReader_detect(): unknown format of %s\n", name);
+  return NULL;
+}
+
+/*
+ * determine format of a file from its leading bytes
+ *
+ * returns NULL if the file can't be read, is not a regular file, or
+ * the format is unknown
+ */
+const canReaderFormat_t *canReader_detect(const char *path)
+{
+  const canReaderFormat_t *format;
+  FILE *fp;
+
+  fp = fopen(path, "rb");
+  if(fp == NULL) {
+    fprintf(stderr, "canReader_detect(): can't open %s\n", path);
+    return NULL;
+  }
+  format = canReader_detectFile(fp, path);
+  fclose(fp);
+  return format;
+}
+
+/*
+ * set number of parser threads of all parallel readers
+ *
+ * n        number of threads, 0 selects the number of online CPUs
+ */
+void canReader_setThreads(unsigned int n)
+{
+  size_t i;
+
+  for(i = 0; i < CANREADER_NFORMATS; i++) {
+    if(canReader_formats[i].setThreads != NULL) {
+      canReader_formats[i].setThreads(n);
+    }
+  }
+}
+
+/* time stamp of message in nanoseconds */
+static inline uint64_t canReader_time(const canMessage_t *message)
+{
+  return (uint64_t)message->t.tv_sec * 1000000000u + message->t.tv_nsec;
+}
+
+/*
+ * open trace file for reading batches of messages
+ *
+ * path     file name, NULL reads from stdin
+ * format   format of the file, NULL determines it from the contents
+ *          of a regular file
+ *
+ * returns NULL on error
+ */
+canReader_t *canReader_open(const char *path,
+                            const canReaderFormat_t *format)
+{
+  canReader_t *r;
+  FILE *fp;
+
+  fp = (path != NULL) ? fopen(path, "rb") : stdin;
+  if(fp == NULL) {
+    fprintf(stderr, "canReader_open(): can't open %s\n", path);
+    return NULL;
+  }
+  if(format == NULL) {
+    /* probe the stream the reader will parse */
+    format = canReader_detectFile(fp, (path != NULL) ? path : "<stdin>");
+    if(format == NULL) goto fail;
+  }
+
+  r = calloc(1, sizeof(*r));
+  if(r == NULL) {
+    fprintf(stderr, "canReader_open(): out of memory\n");
+    goto fail;
+  }
+  r->format = format;
+  r->reader = format->open(fp, path);
+  if(r->reader == NULL) {
+    free(r);
+    return NULL;
+  }
+  return r;
+
+ fail:
+  /* only close what was opened here, stdin stays usable */
+  if(path != NULL) fclose(fp);
+  return NULL;
+}
+
+/*
+ * read next messages
+ *
+ * message  caller-provided array of size entries
+ *
+ * returns the number of messages, 0 at end of file
+ */
+unsigned int canReader_nextBatch(canReader_t *r, canMessage_t *message,
+                                 unsigned int size)
+{
+  unsigned int n;
+
+  while((n = r->format->nextBatch(r->reader, message, size)) > 0) {
+    if(r->seeking) {
+      unsigned int i = 0;
+
+      /* skip messages before the seek time */
+      while((i < n) && (canReader_time(&message[i]) < r->seekTime)) i++;
+      if(i == n) continue;
+      memmove(message, message + i, (n - i) * sizeof(*message));
+      n -= i;
+      r->seeking = 0;
+    }
+    r->lastTime = canReader_time(&message[n - 1]);
+    break;
+  }
+  return n;
+}
+
+/*
+ * continue with the first message at or after time t in nanoseconds
+ *
+ * Seekable readers, e.g. BLF files with a container index, jump to the
+ * time; other readers skip forward to it.
+ *
+ * returns 0 on success, -1 if t lies before the current position of a
+ * reader which can only skip forward
+ */
+int canReader_seekTime(canReader_t *r, uint64_t t)
+{
+  if(   (r->format->seekTime != NULL)
+     && r->format->seekTime(r->reader, t)) {
+    r->lastTime = 0;
+  } else if(t < r->lastTime) {
+    fprintf(stderr, "canReader_seekTime(): can't seek backwards in %s "
+            "file\n", r->format->name);
+    return -1;
+  }
+  r->seekTime = t;
+  r->seeking = 1;
+  return 0;
+}
+
+/* close file and free reader */
+void canReader_close(canReader_t *r)
+{
+  if(r == NULL) return;
+  r->format->close(r->reader);
+  free(r);
+}
@@ -0,0 +1,88 @@
+#ifndef INCLUDE_CANREADER_H
+#define INCLUDE_CANREADER_H
+
+/*  canreader.h -- declarations for canReader
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+#include <stdio.h>
+#include "measurement.h"
+
+/* number of leading bytes passed to the format probes */
+#define CANREADER_PROBE_SIZE 512
+
+/* reader capabilities */
+#define CANREADER_CAP_SEEKABLE  0x01 /* time range read without full scan */
+#define CANREADER_CAP_BATCHABLE 0x02 /* messages handed over in batches */
+#define CANREADER_CAP_PARALLEL  0x04 /* parser threads, see setThreads */
+
+/*
+ * trace file format
+ *
+ * probe        returns 1 if the first n bytes of a file are in this
+ *              format, at most CANREADER_PROBE_SIZE bytes are passed
+ * process      parses the file into a batch and closes it
+ * setThreads   sets the number of parser threads, NULL unless parallel
+ * processRange parses the messages of a time range, NULL unless
+ *              seekable
+ * open         opens a pull-based reader on fp, path may be NULL
+ * nextBatch    fills up to size messages, returns 0 at end of file
+ * seekTime     continues with the messages at or after a time in
+ *              nanoseconds, returns 1 on success, NULL unless seekable
+ * close        closes the file and frees the reader
+ */
+typedef struct {
+  const char      *name;
+  unsigned int     capabilities; /* CANREADER_CAP_* */
+  int            (*probe)(const void *head, size_t n);
+  parserFunction_t process;
+  void           (*setThreads)(unsigned int n);
+  rangeParserFunction_t processRange;
+  void          *(*open)(FILE *fp, const char *path);
+  unsigned int   (*nextBatch)(void *reader, canMessage_t *message,
+                              unsigned int size);
+  int            (*seekTime)(void *reader, uint64_t t);
+  void           (*close)(void *reader);
+} canReaderFormat_t;
+
+const canReaderFormat_t *canReader_format(const char *name);
+const canReaderFormat_t *canReader_detect(const char *path);
+void canReader_setThreads(unsigned int n);
+
+/*
+ * pull-based reader of any format
+ *
+ * The consumer requests batches of messages at its own pace, so
+ * readers can be interleaved, paused or closed early.
+ */
+typedef struct canReader_s canReader_t;
+
+canReader_t *canReader_open(const char *path,
+                            const canReaderFormat_t *format);
+unsigned int canReader_nextBatch(canReader_t *r, canMessage_t *message,
+                                 unsigned int size);
+int          canReader_seekTime(canReader_t *r, uint64_t t);
+void         canReader_close(canReader_t *r);
+
+#endif
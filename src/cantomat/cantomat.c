@@ -19,27 +19,54 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <getopt.h>
+#include <matio.h>
 #include "signalformat.h"
 #include "measurement.h"
 #include "busassignment.h"
 #include "matwrite.h"
-#include "ascreader.h"
-#include "clgreader.h"
-#include "blfreader.h"
-#include "vsbreader.h"
+#include "canreader.h"
 
 int verbose_flag = 0;
 int debug_flag   = 0;
 
 const char *program_name;
 
+static int mat_file_ver = (int)MAT_FT_DEFAULT;
+static int cache_index = 0;
+
 static void usage_error(void)
 {
   fprintf(stderr, "Type '%s --help' for more information\n",program_name);
   exit(1);
 }
 
+/*
+ * parse time in seconds into nanoseconds
+ *
+ * returns 0 on success, -1 if invalid or out of range
+ */
+static int
+parse_seconds(const char *s, uint64_t *ns)
+{
+  char *end;
+  double t;
+
+  errno = 0;
+  t = strtod(s, &end);
+  if(   (end == s) || (*end != '\0') || (errno != 0)
+     || !(t >= 0.0)) {
+    return -1;
+  }
+
+  /* 2^64 ns and more can't be converted */
+  t = t * 1e9 + 0.5;
+  if(t >= 18446744073709551616.0) return -1;
+  *ns = (uint64_t)t;
+  return 0;
+}
+
 static void
 help(void)
 {
@@ -54,9 +81,24 @@ help(void)
           "  -B, --blf <blffile>        BLF input file\n"
           "  -c, --clg <clgfile>        CLG input file\n"
           "  -v, --vsb <vsbfile>        VSB input file\n"
+          "  -i, --input <file>         input file, the format is determined\n"
+          "                             from its contents\n"
           "  -m, --mat <matfile>        MAT output file\n"
+          "      --v5                   output version 5 MAT file\n"
+          "      --v73                  output version 7.3 MAT file, written\n"
+          "                             in slices with --spill-dir\n"
           "  -f, --format <format>      signal name format\n"
           "  -t, --timeres <nanosec>    time resolution\n"
+          "  -j, --threads <n>          number of ASC and BLF reader threads\n"
+          "                             (default: number of CPUs)\n"
+          "      --spill-dir <dir>      store large measurements in temporary\n"
+          "                             files in <dir>\n"
+          "      --mem-budget <MB>      memory for time series before spilling\n"
+          "                             to <dir> (default: 1024)\n"
+          "      --start <sec>          skip messages before <sec> (BLF only)\n"
+          "      --end <sec>            skip messages after <sec> (BLF only)\n"
+          "      --cache-index          keep the container index of --start and\n"
+          "                             --end in <blffile>.idx for later runs\n"
           "      --verbose              verbose output\n"
           "      --brief                brief output (default)\n"
           "      --debug                output debug information\n"
@@ -81,7 +123,12 @@ main(int argc, char **argv)
   measurement_t *measurement;
   int ret = 1;
   sint32 timeResolution = 10000;
-  parserFunction_t parserFunction = NULL;
+  const canReaderFormat_t *format = NULL;
+  char *spillDir = NULL;
+  size_t memBudget = (size_t)1024 << 20;
+  uint64_t startTime = 0;
+  uint64_t endTime = UINT64_MAX;
+  int timeRange = 0;
 
   program_name = argv[0];
 
@@ -92,6 +139,9 @@ main(int argc, char **argv)
       {"verbose", no_argument,       &verbose_flag, 1},
       {"brief",   no_argument,       &verbose_flag, 0},
       {"debug",   no_argument,       &debug_flag,   1},
+      {"v5",      no_argument,       &mat_file_ver, (int)MAT_FT_MAT5},
+      {"v73",     no_argument,       &mat_file_ver, (int)MAT_FT_MAT73},
+      {"cache-index", no_argument,   &cache_index,  1},
       /* These options don't set a flag.
          We distinguish them by their indices. */
       {"asc",     required_argument, 0, 'a'},
@@ -100,9 +150,15 @@ main(int argc, char **argv)
       {"clg",     required_argument, 0, 'c'},
       {"dbc",     required_argument, 0, 'd'},
       {"format",  required_argument, 0, 'f'},
+      {"input",   required_argument, 0, 'i'},
       {"mat",     required_argument, 0, 'm'},
       {"timeres", required_argument, 0, 't'},
+      {"threads", required_argument, 0, 'j'},
       {"vsb",     required_argument, 0, 'v'},
+      {"spill-dir",  required_argument, 0, 'S'},
+      {"mem-budget", required_argument, 0, 'M'},
+      {"start",   required_argument, 0, 's'},
+      {"end",     required_argument, 0, 'e'},
       {"help",    no_argument,    NULL, 'h'},
       {0, 0, 0, 0}
     };
@@ -111,7 +167,7 @@ main(int argc, char **argv)
     int option_index = 0;
     int c;
 
-    c = getopt_long (argc, argv, "a:B:b:c:d:f:m:t:v:",
+    c = getopt_long (argc, argv, "a:B:b:c:d:f:i:j:m:t:v:",
                      long_options, &option_index);
 
     /* Detect the end of the options. */
@@ -122,17 +178,22 @@ main(int argc, char **argv)
       break;
     case 'a':
       inputFilename = optarg;
-      parserFunction =ascReader_processFile;
+      format = canReader_format("ASC");
       inputFiles++;
       break;
     case 'B':
       inputFilename = optarg;
-      parserFunction =blfReader_processFile;
+      format = canReader_format("BLF");
       inputFiles++;
       break;
     case 'c':
       inputFilename = optarg;
-      parserFunction =clgReader_processFile;
+      format = canReader_format("CLG");
+      inputFiles++;
+      break;
+    case 'i':
+      inputFilename = optarg;
+      format = NULL;
       inputFiles++;
       break;
     case 'b':
@@ -173,11 +234,46 @@ main(int argc, char **argv)
     case 't':
       timeResolution = atoi(optarg);
       break;
+    case 'j':
+      canReader_setThreads((unsigned int)atoi(optarg));
+      break;
     case 'v':
       inputFilename = optarg;
-      parserFunction = vsbReader_processFile;
+      format = canReader_format("VSB");
       inputFiles++;
       break;
+    case 'S':
+      spillDir = optarg;
+      break;
+    case 'M': {
+      char *end;
+      unsigned long mb;
+
+      errno = 0;
+      mb = strtoul(optarg, &end, 10);
+      if((end == optarg) || (*end != '\0') || (errno != 0)
+         || (optarg[0] == '-') || (mb > (SIZE_MAX >> 20))) {
+        fprintf(stderr, "error: invalid memory budget %s\n", optarg);
+        busAssignment_free(busAssignment);
+        usage_error();
+      }
+      memBudget = (size_t)mb << 20;
+      break;
+    }
+    case 's':
+      if(parse_seconds(optarg, &startTime) != 0) {
+        fprintf(stderr, "error: invalid start time %s\n", optarg);
+        usage_error();
+      }
+      timeRange = 1;
+      break;
+    case 'e':
+      if(parse_seconds(optarg, &endTime) != 0) {
+        fprintf(stderr, "error: invalid end time %s\n", optarg);
+        usage_error();
+      }
+      timeRange = 1;
+      break;
     case 'h': help(); exit(0);   break;
     case '?':
       /* getopt_long already printed an error message. */
@@ -209,9 +305,36 @@ main(int argc, char **argv)
     busAssignment_free(busAssignment);
     usage_error();
   }
+
+  /* determine input format from the file contents */
+  if(format == NULL) {
+    format = canReader_detect(inputFilename);
+    if(format == NULL) {
+      fprintf(stderr, "error: can't determine format of %s, "
+              "use -a, -B, -c or -v for pipes\n",
+              inputFilename);
+      busAssignment_free(busAssignment);
+      return 1;
+    }
+  }
+
+  /* time range is located e.g. with the container index of BLF files */
+  if(timeRange) {
+    if(!(format->capabilities & CANREADER_CAP_SEEKABLE)) {
+      fprintf(stderr, "error: --start and --end are not supported for "
+              "%s input files\n", format->name);
+      busAssignment_free(busAssignment);
+      usage_error();
+    }
+    if(startTime > endTime) {
+      fprintf(stderr, "error: start time is after end time\n");
+      busAssignment_free(busAssignment);
+      usage_error();
+    }
+  }
   
   /* parse DBC files */
-  if(busAssignment_parseDBC(busAssignment)) {
+  if(busAssignment_parseDBC(busAssignment, signalFormat)) {
     fprintf(stderr, "error: parsing DBC file failed\n");
     exit(1);
   }
@@ -220,22 +343,36 @@ main(int argc, char **argv)
   if(verbose_flag) {
     if(inputFilename != NULL) {
       fprintf(stderr,
-              "Parsing input file %s\n",
+              "Parsing %s input file %s\n",
+              format->name,
               inputFilename?inputFilename:"<stdin>");
     }
   }
-  measurement = measurement_read(busAssignment,
-                                 inputFilename,
-                                 signalFormat,
-                                 timeResolution,
-                                 parserFunction);
+  if(timeRange) {
+    timeRange_t range = { startTime, endTime, cache_index };
+
+    measurement = measurement_readRange(busAssignment,
+                                        inputFilename,
+                                        timeResolution,
+                                        format->processRange,
+                                        &range,
+                                        spillDir,
+                                        memBudget);
+  } else {
+    measurement = measurement_read(busAssignment,
+                                   inputFilename,
+                                   timeResolution,
+                                   format->process,
+                                   spillDir,
+                                   memBudget);
+  }
   if(measurement != NULL) {
 
     /* write MAT file */
     if(verbose_flag) {
       fprintf(stderr, "Writing MAT file %s\n", matFilename);
     }
-    matWrite(measurement, matFilename);
+    matWrite(measurement, matFilename, mat_file_ver);
 
     /* free memory */
     measurement_free(measurement);
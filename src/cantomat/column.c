@@ -0,0 +1,283 @@
+/*  column.c -- chunked column storage for time series
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#include "column.h"
+
+/*
+ * slab strategy:
+ *
+ * blocks are carved from 1 MByte slabs (256 blocks of 4 kByte), so
+ * thousands of columns do not fragment the heap. All slabs are
+ * released at once when the arena is freed.
+ *
+ * With a spill directory, heap slabs are only taken until the memory
+ * budget is used up. Further blocks come from 64 MByte spill slabs,
+ * each a shared mapping of an unlinked temporary file. The kernel
+ * writes dropped pages back to the file, so resident memory stays
+ * close to the budget plus one active block per column.
+ */
+#define COLUMN_SLAB_BLOCKS       256u
+#define COLUMN_SPILL_SLAB_BLOCKS 16384u
+
+typedef struct columnSlab_s {
+  struct columnSlab_s *next;
+  double              *blocks; /* nBlocks blocks */
+  unsigned int         nBlocks;
+  int                  mapped; /* 1: spill slab, 0: heap slab */
+} columnSlab_t;
+
+struct columnArena_s {
+  columnSlab_t *slabs;     /* list of slabs, current slab first */
+  unsigned int  nUsed;     /* blocks used in current slab */
+  char         *spillDir;  /* NULL: no spilling */
+  size_t        memBudget; /* bytes of heap slabs before spilling */
+  size_t        heapBytes; /* bytes of heap slabs allocated */
+};
+
+columnArena_t *columnArena_create(const char *spillDir, size_t memBudget)
+{
+  columnArena_t *arena = malloc(sizeof(*arena));
+
+  if(arena != NULL) {
+    arena->slabs = NULL;
+    arena->nUsed = 0;
+    arena->spillDir = NULL;
+    arena->memBudget = memBudget;
+    arena->heapBytes = 0;
+    if(spillDir != NULL) {
+#ifdef HAVE_MMAP
+      arena->spillDir = strdup(spillDir);
+      if(arena->spillDir == NULL) {
+        free(arena);
+        return NULL;
+      }
+#else
+      fprintf(stderr, "columnArena_create(): spilling to disk is not "
+              "supported on this platform\n");
+#endif
+    }
+  }
+  return arena;
+}
+
+void columnArena_free(columnArena_t *arena)
+{
+  if(arena != NULL) {
+    columnSlab_t *slab = arena->slabs;
+
+    while(slab != NULL) {
+      columnSlab_t *next = slab->next;
+#ifdef HAVE_MMAP
+      if(slab->mapped) {
+        munmap(slab->blocks, (size_t)slab->nBlocks * COLUMN_BLOCK_SIZE
+                             * sizeof(double));
+      } else
+#endif
+      {
+        free(slab->blocks);
+      }
+      free(slab);
+      slab = next;
+    }
+    free(arena->spillDir);
+    free(arena);
+  }
+}
+
+#ifdef HAVE_MMAP
+/* map a new spill slab from an unlinked temporary file */
+static double *columnArena_mapSpillSlab(columnArena_t *arena)
+{
+  size_t len = (size_t)COLUMN_SPILL_SLAB_BLOCKS * COLUMN_BLOCK_SIZE
+               * sizeof(double);
+  size_t dirLen = strlen(arena->spillDir);
+  char *path;
+  void *addr;
+  int fd;
+
+  path = malloc(dirLen + sizeof("/cantomatXXXXXX"));
+  if(path == NULL) return NULL;
+  strcpy(path, arena->spillDir);
+  strcpy(path + dirLen, "/cantomatXXXXXX");
+
+  fd = mkstemp(path);
+  if(fd == -1) {
+    fprintf(stderr, "columnArena_mapSpillSlab(): can't create spill file "
+            "in %s\n", arena->spillDir);
+    free(path);
+    return NULL;
+  }
+  unlink(path);
+  free(path);
+
+  if(ftruncate(fd, (off_t)len) == -1) {
+    fprintf(stderr, "columnArena_mapSpillSlab(): can't extend spill file\n");
+    close(fd);
+    return NULL;
+  }
+  addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED) {
+    fprintf(stderr, "columnArena_mapSpillSlab(): can't map spill file\n");
+    return NULL;
+  }
+  return addr;
+}
+#endif
+
+/* add a new slab to the arena */
+static int columnArena_addSlab(columnArena_t *arena)
+{
+  columnSlab_t *slab = malloc(sizeof(*slab));
+
+  if(slab == NULL) return 0;
+  slab->mapped = 0;
+  slab->nBlocks = COLUMN_SLAB_BLOCKS;
+#ifdef HAVE_MMAP
+  if(arena->spillDir != NULL && arena->heapBytes >= arena->memBudget) {
+    slab->mapped = 1;
+    slab->nBlocks = COLUMN_SPILL_SLAB_BLOCKS;
+    slab->blocks = columnArena_mapSpillSlab(arena);
+  } else
+#endif
+  {
+    slab->blocks = malloc((size_t)slab->nBlocks * COLUMN_BLOCK_SIZE
+                          * sizeof(double));
+    arena->heapBytes += (size_t)slab->nBlocks * COLUMN_BLOCK_SIZE
+                        * sizeof(double);
+  }
+  if(slab->blocks == NULL) {
+    free(slab);
+    return 0;
+  }
+  slab->next = arena->slabs;
+  arena->slabs = slab;
+  arena->nUsed = 0;
+  return 1;
+}
+
+/* take one block from the arena, start a new slab if required,
+   spilled is set if the block lives in the spill file */
+static double *columnArena_allocBlock(columnArena_t *arena, int *spilled)
+{
+  *spilled = 0;
+  if(arena->slabs == NULL || arena->nUsed == arena->slabs->nBlocks) {
+    if(!columnArena_addSlab(arena)) return NULL;
+  }
+  *spilled = arena->slabs->mapped;
+  return arena->slabs->blocks + (size_t)(arena->nUsed++) * COLUMN_BLOCK_SIZE;
+}
+
+/* drop a spilled block from memory, its contents stay in the file */
+static void column_releaseBlock(double *block)
+{
+#ifdef HAVE_MMAP
+  static long pageSize = 0;
+
+  if(pageSize == 0) pageSize = sysconf(_SC_PAGESIZE);
+
+  /* blocks are only page aligned if pages are not larger than blocks */
+  if(pageSize > 0
+     && (COLUMN_BLOCK_SIZE * sizeof(double)) % (size_t)pageSize == 0) {
+    madvise(block, COLUMN_BLOCK_SIZE * sizeof(double), MADV_DONTNEED);
+  }
+#else
+  (void)block;
+#endif
+}
+
+void column_init(column_t *c)
+{
+  c->n = 0;
+  c->nIndex = 0;
+  c->spillFrom = ~0u;
+  c->block = NULL;
+}
+
+/* free block index, the blocks belong to the arena */
+void column_free(column_t *c)
+{
+  free(c->block);
+  column_init(c);
+}
+
+/* append a new block to a full column */
+void column_grow(column_t *c, columnArena_t *arena)
+{
+  unsigned int iBlock = c->n >> COLUMN_BLOCK_SHIFT;
+  int spilled;
+
+  if(iBlock == c->nIndex) {
+    unsigned int nIndex = (c->nIndex == 0) ? 4 : 2 * c->nIndex;
+    double **block = realloc(c->block, nIndex * sizeof(*block));
+
+    if(block == NULL) goto fail;
+    c->block = block;
+    c->nIndex = nIndex;
+  }
+  c->block[iBlock] = columnArena_allocBlock(arena, &spilled);
+  if(c->block[iBlock] == NULL) goto fail;
+  if(spilled && c->spillFrom > iBlock) c->spillFrom = iBlock;
+
+  /* the previous block is full and will not be written again */
+  if(iBlock > 0 && iBlock - 1 >= c->spillFrom) {
+    column_releaseBlock(c->block[iBlock - 1]);
+  }
+  return;
+
+fail:
+  fprintf(stderr, "column_grow(): out of memory\n");
+  exit(EXIT_FAILURE);
+}
+
+/* flatten n values of column, starting at value first, into dest */
+void column_copy(const column_t *c, unsigned int first, unsigned int n,
+                 double *dest)
+{
+  while(n > 0) {
+    unsigned int offset = first & COLUMN_BLOCK_MASK;
+    unsigned int k = COLUMN_BLOCK_SIZE - offset;
+
+    if(k > n) k = n;
+    memcpy(dest, c->block[first >> COLUMN_BLOCK_SHIFT] + offset,
+           k * sizeof(double));
+    dest += k;
+    first += k;
+    n -= k;
+  }
+}
+
+/* drop spilled blocks holding n values starting at value first */
+void column_release(const column_t *c, unsigned int first, unsigned int n)
+{
+  unsigned int i = first >> COLUMN_BLOCK_SHIFT;
+  unsigned int end = (first + n + COLUMN_BLOCK_MASK) >> COLUMN_BLOCK_SHIFT;
+
+  if(i < c->spillFrom) i = c->spillFrom;
+  for(; i < end; i++) {
+    column_releaseBlock(c->block[i]);
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef INCLUDE_COLUMN_H
+#define INCLUDE_COLUMN_H
+
+/*  column.h -- declarations for chunked column storage
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stddef.h>
+
+/*
+ * A column stores doubles in fixed-size blocks taken from an arena.
+ * Blocks are never moved or copied while the column grows; only the
+ * small block index is reallocated.
+ *
+ * If the arena has a spill directory, blocks beyond the memory budget
+ * are taken from memory-mapped temporary files. Full blocks in spill
+ * storage are dropped from memory and paged back in on access.
+ */
+#define COLUMN_BLOCK_SHIFT 9u                       /* 512 values */
+#define COLUMN_BLOCK_SIZE  (1u << COLUMN_BLOCK_SHIFT) /* 4 kByte */
+#define COLUMN_BLOCK_MASK  (COLUMN_BLOCK_SIZE - 1u)
+
+/* arena providing column blocks, freed as a whole */
+typedef struct columnArena_s columnArena_t;
+
+typedef struct {
+  unsigned int n;         /* number of values */
+  unsigned int nIndex;    /* allocated entries of block index */
+  unsigned int spillFrom; /* index of first block in spill storage */
+  double     **block;     /* block index */
+} column_t;
+
+columnArena_t *columnArena_create(const char *spillDir, size_t memBudget);
+void columnArena_free(columnArena_t *arena);
+
+void column_init(column_t *c);
+void column_free(column_t *c);
+void column_grow(column_t *c, columnArena_t *arena);
+void column_copy(const column_t *c, unsigned int first, unsigned int n,
+                 double *dest);
+void column_release(const column_t *c, unsigned int first, unsigned int n);
+
+/* append value to column */
+static inline void column_append(column_t *c, columnArena_t *arena,
+                                 double value)
+{
+  if((c->n & COLUMN_BLOCK_MASK) == 0) column_grow(c, arena);
+  c->block[c->n >> COLUMN_BLOCK_SHIFT][c->n & COLUMN_BLOCK_MASK] = value;
+  c->n++;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef INCLUDE_FILEMAP_H
+#define INCLUDE_FILEMAP_H
+
+/*  filemap.h -- memory mapping of trace files
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#ifdef HAVE_MMAP
+
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * map regular file for sequential reading, release with munmap()
+ *
+ * fd       file descriptor of the file
+ * sizePtr  receives the size of the mapping
+ *
+ * returns NULL if the file is empty, not a regular file, e.g. a pipe,
+ * or can't be mapped
+ */
+static inline void *fileMap_open(int fd, size_t *sizePtr)
+{
+  struct stat st;
+  void *map;
+
+  if(fstat(fd, &st) != 0)                               return NULL;
+  if(!S_ISREG(st.st_mode) || (st.st_size <= 0))         return NULL;
+  if((uintmax_t)st.st_size > SIZE_MAX)                  return NULL;
+
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(map == MAP_FAILED)                                 return NULL;
+#ifdef MADV_SEQUENTIAL
+  madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+
+  *sizePtr = (size_t)st.st_size;
+  return map;
+}
+
+#endif
+
+#endif
@@ -25,65 +25,126 @@
 #include <stdio.h>
 #include <matio.h>
 #include "measurement.h"
-#include "hashtable_itr.h"
 
 /*
- * matWrite - write signals from measurement structure to MAT file
+ * samples per slice appended to MAT 7.3 files, a multiple of the
+ * column block size (2 MByte of time stamps and values)
+ */
+#define MATWRITE_SLICE_SIZE (256u * COLUMN_BLOCK_SIZE)
+
+/*
+ * write n samples starting at sample first as a nx2 array with time
+ * stamps in [0..n-1] and values in [n..2n-1]. Chunked columns are
+ * flattened here, shared time columns are expanded for every signal.
+ * Spilled chunks are dropped from memory again once copied.
  */
-int matWrite(measurement_t *measurement, const char *outFileName)
+static int matWrite_slice(mat_t *mat, const char *name,
+                          const column_t *time, const column_t *value,
+                          unsigned int first, unsigned int n,
+                          double *timeValue, int append)
 {
   size_t dims[2];
+  matvar_t *matvar;
+  int rv;
+
+  column_copy(time, first, n, timeValue);
+  column_copy(value, first, n, timeValue + n);
+  column_release(time, first, n);
+  column_release(value, first, n);
+  dims[0] = n;
+  dims[1] = 2;
+
+  /* matio writes the array in place instead of copying it */
+  matvar = Mat_VarCreate(name, MAT_C_DOUBLE, MAT_T_DOUBLE,
+                         2, dims, timeValue, MAT_F_DONT_COPY_DATA);
+  if(matvar == NULL) return 1;
+#ifdef HAVE_MAT_VARWRITEAPPEND
+  if(append) {
+    rv = Mat_VarWriteAppend(mat, matvar, MAT_COMPRESSION_NONE, 1);
+  } else
+#endif
+  {
+    rv = Mat_VarWrite(mat, matvar, MAT_COMPRESSION_NONE);
+  }
+  Mat_VarFree(matvar);
+  return rv != 0;
+}
+
+/*
+ * matWrite - write signals from measurement structure to MAT file
+ *
+ * Version 7.3 files are written in slices of MATWRITE_SLICE_SIZE
+ * samples if matio supports appending, so memory beyond the
+ * measurement stays bounded for spilled measurements. Other versions
+ * have no partial writes; each variable is then built in one array of
+ * 16 bytes per sample, bounding the memory by the largest variable.
+ */
+int matWrite(measurement_t *measurement, const char *outFileName,
+             int matFileVersion)
+{
   int err = 0;
   mat_t *mat;
-  matvar_t *matvar;
 
-  mat = Mat_Create(outFileName, NULL);
+  mat = Mat_CreateVer(outFileName, NULL, (enum mat_ft)matFileVersion);
   if (mat != NULL) {
 
-    /* loop over all time series */
-    struct hashtable *timeSeriesHash = measurement->timeSeriesHash;
-
-    /* Iterator constructor only returns a valid iterator if
-     * the hashtable is not empty */
-    if (hashtable_count(timeSeriesHash) > 0) {
-
-      struct hashtable_itr *itr = hashtable_iterator(timeSeriesHash);
-      do {
-        char         *signalName = hashtable_iterator_key(itr);
-        timeSeries_t *timeSeries = hashtable_iterator_value(itr);
-        double *timeValue = (double *)malloc(sizeof(double)*2*timeSeries->n);
-        unsigned int i;
-
-        /*
-         * build up a 1x2n array with time stamps in [0..n-1] and
-         * values in [n..2n-1].
-         */
-        for(i=0;i<timeSeries->n;i++) {
-          timeValue[i] = timeSeries->time[i];
-        }
-        for(i=0;i<timeSeries->n;i++) {
-          timeValue[timeSeries->n + i] = timeSeries->value[i];
-        }
-        dims[0] = timeSeries->n;
-        dims[1] = 2;
+    unsigned int k;
+    int append = 0;
+    double *timeValue = NULL;
 
-        /* output signal to mat structure and free up temp array. */
-        matvar = Mat_VarCreate(signalName, MAT_C_DOUBLE, MAT_T_DOUBLE,
-                               2, dims, timeValue, 0);
-        Mat_VarWrite(mat, matvar, 0);
-        Mat_VarFree(matvar);
+#ifdef HAVE_MAT_VARWRITEAPPEND
+    if(Mat_GetVersion(mat) == MAT_FT_MAT73) {
+      append = 1;
+      timeValue = (double *)malloc(sizeof(double) * 2 * MATWRITE_SLICE_SIZE);
+      if(timeValue == NULL) goto fail_alloc;
+    }
+#endif
 
+    /* loop over all time series */
+    for(k = 0; k < measurement->nTimeSeries; k++) {
+      const timeSeries_t *timeSeries = &measurement->timeSeries[k];
+      const column_t *time = (timeSeries->timeColumn != NULL)
+                           ? &timeSeries->timeColumn->time
+                           : &timeSeries->time;
+      const unsigned int n = timeSeries->value.n;
+      unsigned int first;
+
+      /* skip signals without samples */
+      if(n == 0) continue;
+
+      if(append) {
+        for(first = 0; first < n; first += MATWRITE_SLICE_SIZE) {
+          const unsigned int nSlice = (n - first < MATWRITE_SLICE_SIZE)
+                                    ? n - first : MATWRITE_SLICE_SIZE;
+
+          err |= matWrite_slice(mat, timeSeries->name, time,
+                                &timeSeries->value, first, nSlice,
+                                timeValue, 1);
+        }
+      } else {
+        /* whole variable at once */
+        timeValue = (double *)malloc(sizeof(double) * 2 * n);
+        if(timeValue == NULL) goto fail_alloc;
+        err |= matWrite_slice(mat, timeSeries->name, time,
+                              &timeSeries->value, 0, n, timeValue, 0);
         free(timeValue);
-      } while (hashtable_iterator_advance(itr));
-      free(itr);
+        timeValue = NULL;
+      }
     }
-
+    free(timeValue);
     Mat_Close(mat);
+    if(err) {
+      fprintf(stderr, "error: could not write MAT file %s\n", outFileName);
+    }
   } else {
     fprintf(stderr, "error: could not create MAT file %s\n", outFileName);
     err = 1;
   }
 
   return err;
-}
 
+fail_alloc:
+  fprintf(stderr, "matWrite(): out of memory\n");
+  Mat_Close(mat);
+  return 1;
+}
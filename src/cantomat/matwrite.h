@@ -22,6 +22,8 @@
 #include <stdio.h>
 #include "measurement.h"
 
-int matWrite(measurement_t *measurement, const char *filename);
+/* matFileVersion is one of enum mat_ft, e.g. MAT_FT_DEFAULT */
+int matWrite(measurement_t *measurement, const char *filename,
+             int matFileVersion);
 
 #endif
@@ -17,14 +17,13 @@
 #include "cantools_config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include "measurement.h"
 #include "busassignment.h"
 #include "messagehash.h"
 #include "signalformat.h"
-#include "hashtable.h"
-#include "hashtable_itr.h"
 #include "ascreader.h"
 #include "messagedecoder.h"
 #include "vsbreader.h"
@@ -32,55 +31,35 @@
 
 /* callback structure for timeSeries signal handler */
 typedef struct {
-  struct hashtable *timeSeriesHash;
-  char             *local_prefix;
+  measurement_t *measurement;
 } signalProcCbData_t;
 
 /* callback structure for timeSeries message handler */
 typedef struct {
   busAssignment_t *busAssignment;
   measurement_t   *measurement;
-  signalFormat_t   signalFormat;
   sint32           timeResolution;
 } messageProcCbData_t;
 
-/* simple string hash function for signal names */
-static unsigned int signalName_computeHash( void *k)
-{
-  unsigned int hash = 0;
-  int c;
-
-  while ((c = *(unsigned char *)k++)) {
-    hash = c + (hash << 6) + (hash << 16) - hash;
-  }
-
-  return hash;
-}
-
-/* string comparison function for signal names */
-static int signalNames_equal ( void *key1, void *key2 )
-{
-  return strcmp((char *)key1, (char *)key2) == 0;
-}
-
 /* used only for debugging: print data to stderr */
 static void signalProc_print(
-  const signal_t *s,
-  const canMessage_t *canMessage,
-  uint32 rawValue,
+  const signalLayout_t *sl,
+  double dtime,
+  uint64_t rawValue,
   double physicalValue,
   void *cbData)
 {
   /* recover callback data */
   signalProcCbData_t *signalProcCbData = (signalProcCbData_t *)cbData;
-  char *outputSignalName =
-    signalFormat_stringAppend(signalProcCbData->local_prefix, s->name);
-  
-  fprintf(stderr,"   %s\t=%f ~ raw=%ld\t~ %d|%d@%d%c (%f,%f)"
+  const signal_t *s = sl->signal;
+  const char *outputSignalName =
+    signalProcCbData->measurement->timeSeries[sl->slot].name;
+
+  fprintf(stderr,"   %s\t=%f ~ raw=%llu\t~ %d|%d@%d%c (%f,%f)"
           " [%f|%f] %d %ul \"%s\"\n",
           outputSignalName,
           physicalValue,
-          rawValue,
+          (unsigned long long)rawValue,
           s->bit_start,
           s->bit_len,
           s->endianess,
@@ -92,151 +71,172 @@ static void signalProc_print(
           s->mux_type,
           (unsigned int)s->mux_value,
           s->comment!=NULL?s->comment:"");
-
-  /* free temp. signal name */
-  if(outputSignalName != NULL) free(outputSignalName);
 }
 
 /*
- * Add signal value to time series array
+ * Add signal value to time series
  *
- * For large measurements, this code should eventually be replaced by
- * a file based storage.
+ * Values are appended to chunked columns, so a growing series is
+ * never copied. For large measurements, the arena moves the chunks to
+ * memory-mapped files once its memory budget is used up.
  */
 static void signalProc_timeSeries(
-  const signal_t *s,
-  double          dtime,
-  uint32          rawValue,
-  double          physicalValue,
-  void           *cbData)
+  const signalLayout_t *sl,
+  double                dtime,
+  uint64_t              rawValue,
+  double                physicalValue,
+  void                 *cbData)
 {
-  /*
-   * realloc strategy:
-   *
-   * reallocate in 1kByte (128*sizeof(double)) blocks.
-   *
-   * Increasing realloc step size improves performance only marginally
-   * (tested on x86-32), but increases memory waste.
-   *
-   * realloc_count must be a power of 2.
-   */
-  const unsigned int realloc_count = (1u<<7u);
-
   /* recover callback data */
   signalProcCbData_t *signalProcCbData = (signalProcCbData_t *)cbData;
+  measurement_t *measurement = signalProcCbData->measurement;
 
-  /* assemble final signal name */
-  char *outputSignalName = 
-    signalFormat_stringAppend(signalProcCbData->local_prefix, s->name);
-  
-  /* look for signal in time series hash */
-  timeSeries_t *timeSeries = hashtable_search(signalProcCbData->timeSeriesHash,
-                                              (void *)outputSignalName);
-
-  /* allocate new time series structure on first value */
-  if(NULL == timeSeries) {
-    timeSeries = (timeSeries_t *)malloc(sizeof(*timeSeries));
-    timeSeries->n = 0;
-    timeSeries->time = NULL;
-    timeSeries->value = NULL;
-    hashtable_insert(signalProcCbData->timeSeriesHash,
-                     (void *)strdup(outputSignalName),
-                     (void *)timeSeries);
-  }
+  /* output signal name was resolved to a slot at DBC load time */
+  timeSeries_t *timeSeries = &measurement->timeSeries[sl->slot];
 
-  /* perform reallocation if allocated buffer would be exceeded */
-  if((timeSeries->n & (realloc_count-1)) == 0) {
-    unsigned int newsize = (timeSeries->n & ~(realloc_count-1)) + realloc_count;
-    timeSeries->time  = realloc(timeSeries->time, sizeof(double)*newsize);
-    timeSeries->value = realloc(timeSeries->value, sizeof(double)*newsize);
+  /*
+   * Signals sharing a time column: the first signal of a frame
+   * finds the column at the same length as its own series and
+   * appends the time stamp for all signals of the message.
+   */
+  if(timeSeries->timeColumn != NULL) {
+    column_t *time = &timeSeries->timeColumn->time;
+
+    if(time->n == timeSeries->value.n) {
+      column_append(time, measurement->arena, dtime);
+    }
+  } else {
+    column_append(&timeSeries->time, measurement->arena, dtime);
   }
 
   /* append entry to time series */
-  timeSeries->time [timeSeries->n] = dtime;
-  timeSeries->value[timeSeries->n] = physicalValue;
-  timeSeries->n++;
+  column_append(&timeSeries->value, measurement->arena, physicalValue);
+}
+
+/* frame of a batch, ordered by message layout */
+typedef struct {
+  const messageLayout_t *layout; /* NULL: decoded in frame order */
+  unsigned int           index;  /* position of frame in batch */
+} batchEntry_t;
 
-  /* free temp. signal name */
-  if(outputSignalName != NULL) free(outputSignalName);
+static int batchEntry_compare(const void *a, const void *b)
+{
+  const batchEntry_t *ea = (const batchEntry_t *)a;
+  const batchEntry_t *eb = (const batchEntry_t *)b;
+
+  if(ea->layout != eb->layout) {
+    return ((uintptr_t)ea->layout < (uintptr_t)eb->layout) ? -1 : 1;
+  }
+  return (ea->index < eb->index) ? -1 : (ea->index > eb->index);
 }
 
 /*
- * callback function for processing a CAN message
+ * callback function for processing a batch of CAN messages
+ *
+ * All frames are looked up first, then the frames of each message
+ * are decoded together. Sorting is stable, so every time series
+ * still receives its samples in file order. Messages sharing output
+ * signals with other messages are decoded in frame order.
  */
-static void canMessage_process(canMessage_t *canMessage, void *cbData)
+static void canMessage_processBatch(canMessage_t *canMessage,
+                                    unsigned int n, void *cbData)
 {
   messageProcCbData_t *messageProcCbData = (messageProcCbData_t *)cbData;
-
-  /* lookup canMessage in message hash */
-  messageHashKey_t key = canMessage->id;
-  message_t *dbcMessage;
-  int i;
-
-  /* loop over all bus assigments */
-  for(i = 0; i < messageProcCbData->busAssignment->n ; i++) {
-    busAssignmentEntry_t *entry = &messageProcCbData->busAssignment->list[i];
-
-    /* check if bus matches */
-    if((entry->bus == -1) || (entry->bus == canMessage->bus)) {
-      if(NULL != (dbcMessage = hashtable_search(entry->messageHash, &key))) {
-
-        /* found the message in the database */
-        char *local_prefix;
-        const char *const prefix = NULL;
-        
-        /* setup and forward message prefix */
-        if(messageProcCbData->signalFormat & signalFormat_Message) {
-          local_prefix = signalFormat_stringAppend(prefix, dbcMessage->name);
-        } else {
-          if(prefix != NULL) local_prefix = strdup(prefix);
-          else               local_prefix = NULL;
-        }
-
-        /* call message decoder with time series storage callback */
-        {
-          signalProcCbData_t signalProcCbData = {
-            messageProcCbData->measurement->timeSeriesHash,
-            local_prefix,
-          };
-
-          canMessage_decode(dbcMessage,
-                            canMessage,
-                            messageProcCbData->timeResolution,
-                            signalProc_timeSeries,
-                            &signalProcCbData);
-        }
-
-        /* free local prefix */
-        if(local_prefix != NULL) free(local_prefix);
-
-        /* end search if message was found */
-        break;
+  signalProcCbData_t signalProcCbData = {
+    messageProcCbData->measurement
+  };
+  messageLayout_t *layout[MSGBATCH_SIZE];
+  batchEntry_t entry[MSGBATCH_SIZE];
+  canMessage_t *frame[MSGBATCH_SIZE];
+  unsigned int first;
+
+  for(first = 0; first < n; first += MSGBATCH_SIZE) {
+    unsigned int m = (n - first < MSGBATCH_SIZE) ? n - first : MSGBATCH_SIZE;
+    unsigned int nEntry = 0;
+    unsigned int i, k;
+
+    /* lookup messages in the dispatch table of their bus */
+    for(i = 0; i < m; i++) {
+      const canMessage_t *cm = &canMessage[first + i];
+
+      layout[i] = busAssignment_lookup(messageProcCbData->busAssignment,
+                                       cm->bus, cm->id);
+      if(layout[i] != NULL) {
+        entry[nEntry].layout = layout[i]->exclusive ? layout[i] : NULL;
+        entry[nEntry].index = i;
+        nEntry++;
+      }
+    }
+    qsort(entry, nEntry, sizeof(*entry), batchEntry_compare);
+
+    /* decode runs of frames with the same layout */
+    for(i = 0; i < nEntry; i = k) {
+      if(entry[i].layout == NULL) {
+        canMessage_decode(layout[entry[i].index],
+                          &canMessage[first + entry[i].index],
+                          messageProcCbData->timeResolution,
+                          signalProc_timeSeries,
+                          &signalProcCbData);
+        k = i + 1;
+        continue;
+      }
+      for(k = i; (k < nEntry) && (entry[k].layout == entry[i].layout); k++) {
+        frame[k - i] = &canMessage[first + entry[k].index];
       }
+      canMessage_decodeBatch(entry[i].layout, frame, k - i,
+                             messageProcCbData->timeResolution,
+                             signalProc_timeSeries,
+                             &signalProcCbData);
     }
   }
 }
 
 /*
  * process CAN trace file with given bus assignment and output
- * signal format
+ * signal format, with rangeParserFunction if not NULL
  */
-measurement_t *measurement_read(busAssignment_t *busAssignment,
-                                const char *filename,
-                                signalFormat_t signalFormat,
-                                sint32 timeResolution,
-                                parserFunction_t parserFunction)
+static measurement_t *
+measurement_readFile(busAssignment_t *busAssignment,
+                     const char *filename,
+                     sint32 timeResolution,
+                     parserFunction_t parserFunction,
+                     rangeParserFunction_t rangeParserFunction,
+                     const timeRange_t *range,
+                     const char *spillDir,
+                     size_t memBudget)
 {
   FILE *fp;
   measurement_t *measurement;
 
   measurement = malloc(sizeof(measurement_t));
   if(measurement!= NULL) {
-    /* create time series hash */
-    measurement->timeSeriesHash = create_hashtable(
-        16,
-        signalName_computeHash,
-        signalNames_equal);
-    if(measurement->timeSeriesHash != NULL) {
+    /* create one time series slot per interned output signal name */
+    measurement->nTimeSeries = busAssignment->nSignalNames;
+    measurement->timeSeries = calloc(busAssignment->nSignalNames + 1,
+                                     sizeof(*measurement->timeSeries));
+    measurement->nTimeColumns = busAssignment->nTimeColumns;
+    measurement->timeColumns = calloc(busAssignment->nTimeColumns + 1,
+                                      sizeof(*measurement->timeColumns));
+    measurement->arena = columnArena_create(spillDir, memBudget);
+    if(   (measurement->timeSeries != NULL)
+       && (measurement->timeColumns != NULL)
+       && (measurement->arena != NULL)) {
+      unsigned int i;
+
+      for(i = 0; i < measurement->nTimeColumns; i++) {
+        column_init(&measurement->timeColumns[i].time);
+      }
+      for(i = 0; i < measurement->nTimeSeries; i++) {
+        unsigned int column = busAssignment->signalTimeColumn[i];
+
+        measurement->timeSeries[i].name = busAssignment->signalNames[i];
+        column_init(&measurement->timeSeries[i].time);
+        column_init(&measurement->timeSeries[i].value);
+        if(column != BUSASSIGNMENT_PRIVATE_TIME) {
+          measurement->timeSeries[i].timeColumn =
+            &measurement->timeColumns[column];
+        }
+      }
 
       /* open input file */
       if(filename != NULL) {
@@ -249,26 +249,44 @@ measurement_t *measurement_read(busAssignment_t *busAssignment,
         messageProcCbData_t messageProcCbData = {
           busAssignment,
           measurement,
-          signalFormat,
           timeResolution
         };
-
-        /*
-         * invoke the file format parser on file pointer fp
-         * the parser function is responsible for closing the input
-         * file stream
-         */
-        parserFunction(fp, canMessage_process, &messageProcCbData);
-
+        canMessage_t *message = malloc(MSGBATCH_SIZE * sizeof(*message));
+        msgBatch_t batch;
+
+        if(message != NULL) {
+          msgBatch_init(&batch, message, MSGBATCH_SIZE,
+                        canMessage_processBatch, &messageProcCbData);
+
+          /*
+           * invoke the file format parser on file pointer fp
+           * the parser function is responsible for closing the input
+           * file stream
+           */
+          if(rangeParserFunction != NULL) {
+            rangeParserFunction(fp, filename, range, &batch);
+          } else {
+            parserFunction(fp, &batch);
+          }
+          free(message);
+        } else {
+          fprintf(stderr, "measurement_read(): can't allocate batch\n");
+          if(fp != stdin) fclose(fp);
+        }
       } else {
         fprintf(stderr, "measurement_read(): can't open input file\n");
-        hashtable_destroy(measurement->timeSeriesHash, 0);
+        free(measurement->timeSeries);
+        free(measurement->timeColumns);
+        columnArena_free(measurement->arena);
         free(measurement);
         measurement = NULL;
       }
     } else {
       fprintf(stderr,
-              "measurement_read(): can't create time series hash table\n");
+              "measurement_read(): can't allocate time series array\n");
+      free(measurement->timeSeries);
+      free(measurement->timeColumns);
+      columnArena_free(measurement->arena);
       free(measurement);
       measurement = NULL;
     }
@@ -279,31 +297,62 @@ measurement_t *measurement_read(busAssignment_t *busAssignment,
   return measurement;
 }
 
+/*
+ * process CAN trace file with given bus assignment and output
+ * signal format. If spillDir is not NULL, time series exceeding
+ * memBudget bytes are stored in temporary files in spillDir.
+ */
+measurement_t *measurement_read(busAssignment_t *busAssignment,
+                                const char *filename,
+                                sint32 timeResolution,
+                                parserFunction_t parserFunction,
+                                const char *spillDir,
+                                size_t memBudget)
+{
+  return measurement_readFile(busAssignment, filename, timeResolution,
+                              parserFunction, NULL, NULL,
+                              spillDir, memBudget);
+}
+
+/*
+ * process the messages of a time range in a CAN trace file, see
+ * measurement_read()
+ */
+measurement_t *measurement_readRange(busAssignment_t *busAssignment,
+                                     const char *filename,
+                                     sint32 timeResolution,
+                                     rangeParserFunction_t rangeParserFunction,
+                                     const timeRange_t *range,
+                                     const char *spillDir,
+                                     size_t memBudget)
+{
+  return measurement_readFile(busAssignment, filename, timeResolution,
+                              NULL, rangeParserFunction, range,
+                              spillDir, memBudget);
+}
+
 /* free measurement structure */
 void measurement_free(measurement_t *m)
 {
   // fprintf(stderr,"freeing %p (measurement)\n",m);
   if(m != NULL) {
+    unsigned int i;
+
+    /* free time series, signal names belong to the bus assignment */
+    for(i = 0; i < m->nTimeSeries; i++) {
+      column_free(&m->timeSeries[i].time);
+      column_free(&m->timeSeries[i].value);
+    }
+    free(m->timeSeries);
 
-    /* free time series */
-    struct hashtable *timeSeriesHash = m->timeSeriesHash;
-    struct hashtable_itr *itr;
-
-    /* loop over all time series in hash */
-    if (hashtable_count(timeSeriesHash) > 0) {
-      itr = hashtable_iterator(timeSeriesHash);
-      do {
-        char         *signalName = hashtable_iterator_key(itr);
-        timeSeries_t *timeSeries = hashtable_iterator_value(itr);
-
-        free(timeSeries->time);
-        free(timeSeries->value);
-      } while (hashtable_iterator_advance(itr));
-      free(itr);
+    /* free shared time columns */
+    for(i = 0; i < m->nTimeColumns; i++) {
+      column_free(&m->timeColumns[i].time);
     }
+    free(m->timeColumns);
 
-    /* free key and value (timeSeries_t) and hashTable */
-    hashtable_destroy(m->timeSeriesHash, 1);
+    /* release all column blocks at once */
+    columnArena_free(m->arena);
     free(m);
   }
 }
@@ -19,11 +19,26 @@
 
 #include "cantools_config.h"
 
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
 #include <stdio.h>
 
-#include "hashtable.h"
 #include "busassignment.h"
 #include "signalformat.h"
+#include "column.h"
+
+/* maximum payload length of CAN FD frames */
+#define CANMESSAGE_MAX_LEN 64
+
+/* CAN message flags */
+#define CANMESSAGE_FLAG_FD  0x01 /* CAN FD frame */
+#define CANMESSAGE_FLAG_BRS 0x02 /* bit rate switch */
+#define CANMESSAGE_FLAG_ESI 0x04 /* error state indicator */
 
 /* CAN message type */
 typedef struct {
@@ -33,30 +48,167 @@ typedef struct {
   } t; /* time stamp */
   uint8   bus;     /* can bus */
   uint32  id;      /* numeric CAN-ID */
-  uint8   dlc;
-  uint8   byte_arr[8];
+  uint8   dlc;     /* data length code as transmitted */
+  uint8   len;     /* payload length in bytes */
+  uint8   flags;   /* CANMESSAGE_FLAG_* */
+  uint8   byte_arr[CANMESSAGE_MAX_LEN];
 } canMessage_t;
 
+/*
+ * map data length code to payload length
+ *
+ * classic CAN frames carry at most 8 bytes, DLC values 9..15 also
+ * denote 8 bytes. CAN FD frames use DLC 9..15 for 12..64 bytes.
+ */
+static inline uint8 canMessage_dlcToLen(uint8 dlc, int fd)
+{
+  static const uint8 fdLen[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+  };
+
+  if(dlc > 15) dlc = 15;
+  if(fd) return fdLen[dlc];
+  return (dlc > 8) ? 8 : dlc;
+}
+
 /* message received callback function */
 typedef void (* msgRxCb_t)(canMessage_t *message, void *cbData);
 
+/* batch of messages received callback function */
+typedef void (* msgRxBatchCb_t)(canMessage_t *message, unsigned int n,
+                                void *cbData);
+
+/* default number of messages per batch */
+#define MSGBATCH_SIZE 256
+
+/*
+ * batch of received messages
+ *
+ * Readers fill the caller-provided message array in place and hand
+ * it over to msgRxBatchCb when it is full and at end of file. A batch
+ * without callback is filled up to its size, readers stop when it is
+ * full, see msgBatch_full().
+ */
 typedef struct {
-  struct hashtable *timeSeriesHash;
-} measurement_t;
+  canMessage_t  *message;      /* caller-provided array */
+  unsigned int   size;         /* number of entries of array */
+  unsigned int   n;            /* number of filled entries */
+  msgRxBatchCb_t msgRxBatchCb;
+  void          *cbData;
+} msgBatch_t;
+
+static inline void msgBatch_init(msgBatch_t *batch,
+                                 canMessage_t *message, unsigned int size,
+                                 msgRxBatchCb_t msgRxBatchCb, void *cbData)
+{
+  batch->message      = message;
+  batch->size         = size;
+  batch->n            = 0;
+  batch->msgRxBatchCb = msgRxBatchCb;
+  batch->cbData       = cbData;
+}
+
+/* hand over filled entries */
+static inline void msgBatch_flush(msgBatch_t *batch)
+{
+  if((batch->n > 0) && (batch->msgRxBatchCb != NULL)) {
+    batch->msgRxBatchCb(batch->message, batch->n, batch->cbData);
+    batch->n = 0;
+  }
+}
+
+/* next entry to be filled by the reader */
+static inline canMessage_t *msgBatch_next(msgBatch_t *batch)
+{
+  return &batch->message[batch->n];
+}
+
+/* append the entry returned by msgBatch_next() to the batch */
+static inline void msgBatch_commit(msgBatch_t *batch)
+{
+  if(++batch->n == batch->size) msgBatch_flush(batch);
+}
+
+/* no more entries can be filled, only for batches without callback */
+static inline int msgBatch_full(const msgBatch_t *batch)
+{
+  return batch->n == batch->size;
+}
+
+/*
+ * adapter for per-message callbacks: readers implement the batch
+ * interface, their per-message interface delivers each message of a
+ * batch to msgRxCb in order
+ */
+typedef struct {
+  msgRxCb_t msgRxCb;
+  void     *cbData;
+} msgRxAdapter_t;
+
+/* number of messages per batch of the adapter */
+#define MSGBATCH_ADAPTER_SIZE 64
+
+static inline void msgRxAdapter_batchCb(canMessage_t *message,
+                                        unsigned int n, void *cbData)
+{
+  msgRxAdapter_t *adapter = (msgRxAdapter_t *)cbData;
+  unsigned int i;
+
+  for(i = 0; i < n; i++) adapter->msgRxCb(&message[i], adapter->cbData);
+}
+
+/* time stamps shared by all signals of one message */
+typedef struct {
+  column_t time;
+} timeColumn_t;
 
 typedef struct {
-  unsigned int n;
-  double *time;
-  double *value;
+  const char *name;   /* output signal name (owned by bus assignment) */
+  timeColumn_t *timeColumn; /* shared time stamps, NULL if private */
+  column_t time;      /* private time stamps, empty if shared */
+  column_t value;
 } timeSeries_t;
 
-typedef void (* parserFunction_t)(FILE *fp, msgRxCb_t msgRxCb, void *cbData);
+typedef struct {
+  unsigned int   nTimeSeries;
+  timeSeries_t  *timeSeries; /* array indexed by signal slot */
+  unsigned int   nTimeColumns;
+  timeColumn_t  *timeColumns;
+  columnArena_t *arena;      /* storage of all columns */
+} measurement_t;
+
+typedef void (* parserFunction_t)(FILE *fp, msgBatch_t *batch);
+
+/*
+ * time range of the messages to read in nanoseconds
+ *
+ * Seekable formats locate the range with an index of the file, which
+ * is kept next to the file for later reads if cacheIndex is set.
+ */
+typedef struct {
+  uint64_t startTime;
+  uint64_t endTime;
+  int      cacheIndex;
+} timeRange_t;
+
+/* parser of the messages in a time range, path is the name of fp */
+typedef void (* rangeParserFunction_t)(FILE *fp, const char *path,
+                                       const timeRange_t *range,
+                                       msgBatch_t *batch);
 
 measurement_t *measurement_read(busAssignment_t *busAssignment,
                                 const char *filename,
-                                signalFormat_t signalFormat,
 				sint32 timeResolution,
-				parserFunction_t parserFunction);
+				parserFunction_t parserFunction,
+				const char *spillDir,
+				size_t memBudget);
+measurement_t *measurement_readRange(busAssignment_t *busAssignment,
+                                     const char *filename,
+                                     sint32 timeResolution,
+                                     rangeParserFunction_t rangeParserFunction,
+                                     const timeRange_t *range,
+                                     const char *spillDir,
+                                     size_t memBudget);
 
 void measurement_free(measurement_t *m);
 
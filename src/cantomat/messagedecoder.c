@@ -16,18 +16,460 @@
 
 #include "cantools_config.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "dbcmodel.h"
 #include "messagedecoder.h"
 
-void canMessage_decode(message_t      *dbcMessage,
-                       canMessage_t   *canMessage,
-                       sint32          timeResolution,
-                       signalProcCb_t  signalProcCb,
-                       void           *cbData)
+/*
+ * compile extraction plan of a single signal
+ *
+ * signal bit order:
+ *
+ *     7  6  5  4  3  2  1  0 offset
+ *    bit
+ * 0   7  6  5  4  3  2  1  0
+ * 1  15 14 13 12 11 10  9  8
+ * 2  23 22 21 20 19 18 17 16
+ * 3  31 30 29 28 27 26 25 24
+ * 4  39 38 37 36 35 34 33 32
+ * 5  47 46 45 44 43 42 41 40
+ * 6  55 54 53 52 51 50 49 48
+ * 7  63 62 61 60 59 58 57 56
+ * |
+ * start_byte
+ *
+ * Little endian signals occupy the bits bit_start .. bit_start +
+ * bit_len - 1 of the payload loaded in little endian byte order.
+ *
+ * Big endian signals start with their MSB at bit_start and continue
+ * towards lower offsets and higher bytes. Loading the payload in big
+ * endian byte order makes them contiguous as well: byte base occupies
+ * bits 63..56, so the MSB is found at (7 - (start_byte - base)) * 8 +
+ * start_offset.
+ *
+ * CAN FD payloads extend the table above up to byte 63. Signals
+ * outside of the first 8 bytes are extracted from a payload word
+ * starting at a later byte.
+ *
+ * returns 0, if the signal does not fit into the CAN FD payload
+ */
+static int signalLayout_init(signalLayout_t *sl, const signal_t *s)
+{
+  unsigned int len = s->bit_len;
+  unsigned int base;
+  unsigned int lsb;
+
+  if((len == 0) || (len > 64)) return 0;
+  if(s->bit_start >= CANMESSAGE_MAX_LEN * 8) return 0;
+
+  sl->wide = 0;
+
+  /* 0 = Big Endian, 1 = Little Endian */
+  if(s->endianess == 0) {
+    unsigned int byte   = s->bit_start / 8;
+    unsigned int offset = s->bit_start & 7;
+    unsigned int msb;
+
+    /* prefer the payload word of classic frames */
+    base = (byte < 8) ? 0 : ((byte < 56) ? byte : 56);
+    msb = (7 - (byte - base)) * 8 + offset;
+    if(msb + 1 < len) {
+      /* retry with payload word starting at the MSB */
+      base = (byte < 56) ? byte : 56;
+      msb = (7 - (byte - base)) * 8 + offset;
+    }
+    if(msb + 1 >= len) {
+      lsb = msb + 1 - len;
+      sl->minLen = base + 8 - lsb / 8;
+    } else {
+      /* add the byte following the payload word as lowest 8 bits */
+      if(byte != base || byte + 8 >= CANMESSAGE_MAX_LEN) return 0;
+      lsb = msb + 8 + 1 - len;
+      sl->wide = 1;
+      sl->minLen = base + 9;
+    }
+    sl->bigEndian = 1;
+  } else {
+    lsb = s->bit_start;
+    if(lsb + len > CANMESSAGE_MAX_LEN * 8) return 0;
+    sl->minLen = (lsb + len + 7) / 8;
+    if(lsb + len <= 64) {
+      base = 0;
+    } else {
+      base = lsb / 8;
+      if(base > 56) base = 56;
+      lsb -= base * 8;
+      if(lsb + len > 64) sl->wide = 1;
+    }
+    sl->bigEndian = 0;
+  }
+
+  sl->signal   = s;
+  sl->base     = (uint8_t)base;
+  sl->shift    = (uint8_t)lsb;
+  sl->mask     = (len == 64) ? ~(uint64_t)0 : (((uint64_t)1 << len) - 1);
+  sl->isSigned = s->signedness ? 1 : 0;
+  sl->signBit  = (s->signedness && (len < 64))
+                 ? ((uint64_t)1 << (len - 1)) : 0;
+  sl->scale    = s->scale;
+  sl->offset   = s->offset;
+  sl->slot     = 0;
+  return 1;
+}
+
+/*
+ * jump table policy: multiplexor values are looked up in a dense
+ * table if it stays small or is at least a quarter populated,
+ * otherwise by binary search
+ */
+#define MUXTABLE_DENSE_MIN 256u
+
+/*
+ * order multiplexed signal plans by multiplexor value, keeping the
+ * DBC order within a group (insertion sort is stable, and it runs
+ * only once per message)
+ */
+static void signalLayout_sortMux(signalLayout_t *plans, unsigned int n)
+{
+  unsigned int i;
+
+  for(i = 1; i < n; i++) {
+    signalLayout_t plan = plans[i];
+    unsigned int j = i;
+
+    while((j > 0)
+          && (plans[j - 1].signal->mux_value > plan.signal->mux_value)) {
+      plans[j] = plans[j - 1];
+      j--;
+    }
+    plans[j] = plan;
+  }
+}
+
+/* set payload length required by a group of signals */
+static void signalGroup_init(signalGroup_t *group, signalLayout_t *signals,
+                             unsigned int nSignals, uint32_t muxValue)
+{
+  unsigned int i;
+
+  group->muxValue   = muxValue;
+  group->minLen     = 0;
+  group->timeColumn = 0;
+  group->nSignals   = nSignals;
+  group->signals    = signals;
+  for(i = 0; i < nSignals; i++) {
+    if(signals[i].minLen > group->minLen) group->minLen = signals[i].minLen;
+  }
+}
+
+/*
+ * split multiplexed signal plans into groups and build the jump
+ * table from multiplexor value to group
+ *
+ * returns 0 on success, 1 on allocation failure
+ */
+static int messageLayout_buildGroups(messageLayout_t *layout,
+                                     signalLayout_t *muxed,
+                                     unsigned int nMuxed)
+{
+  unsigned int i, first;
+  uint32_t maxValue;
+
+  if(nMuxed == 0) return 0;
+
+  signalLayout_sortMux(muxed, nMuxed);
+
+  layout->nGroups = 1;
+  for(i = 1; i < nMuxed; i++) {
+    if(muxed[i].signal->mux_value != muxed[i - 1].signal->mux_value) {
+      layout->nGroups++;
+    }
+  }
+  layout->groups = malloc(layout->nGroups * sizeof(*layout->groups));
+  if(layout->groups == NULL) return 1;
+
+  layout->nGroups = 0;
+  for(first = 0, i = 1; i <= nMuxed; i++) {
+    if(   (i == nMuxed)
+       || (muxed[i].signal->mux_value != muxed[first].signal->mux_value)) {
+      signalGroup_init(&layout->groups[layout->nGroups++], &muxed[first],
+                       i - first, muxed[first].signal->mux_value);
+      first = i;
+    }
+  }
+
+  /* dense jump table */
+  maxValue = layout->groups[layout->nGroups - 1].muxValue;
+  if(   (maxValue < MUXTABLE_DENSE_MIN)
+     || (maxValue / 4 < layout->nGroups)) {
+    layout->nMuxTable = maxValue + 1;
+    layout->muxTable = calloc(layout->nMuxTable, sizeof(*layout->muxTable));
+    if(layout->muxTable == NULL) return 1;
+    for(i = 0; i < layout->nGroups; i++) {
+      layout->muxTable[layout->groups[i].muxValue] = &layout->groups[i];
+    }
+  }
+  return 0;
+}
+
+/*
+ * build compiled message layout from DBC message
+ *
+ * the layout takes ownership of the message structure
+ */
+messageLayout_t *messageLayout_create(message_t *message)
 {
   signal_list_t *sl;
+  signalLayout_t *plans = NULL;
+  unsigned int n = 0;
+  unsigned int nPlans = 0;
+  unsigned int nBase = 0;
+  unsigned int i;
+  const signal_t *muxSignal = NULL;
+  CREATE(messageLayout_t, layout);
+
+  if(layout == NULL) return NULL;
+
+  for(sl = message->signal_list; sl != NULL; sl = sl->next) n++;
+
+  layout->message    = message;
+  layout->needLE     = 0;
+  layout->needBE     = 0;
+  layout->classic    = 1;
+  layout->exclusive  = 0;
+  layout->mux        = NULL;
+  layout->nGroups    = 0;
+  layout->groups     = NULL;
+  layout->nMuxTable  = 0;
+  layout->muxTable   = NULL;
+  layout->nSignals   = 0;
+  layout->signals    = (n > 0) ? malloc(n * sizeof(*layout->signals)) : NULL;
+  if(n > 0) {
+    plans = malloc(n * sizeof(*plans));
+    if((layout->signals == NULL) || (plans == NULL)) goto fail;
+  }
+
+  /* compile plans, the first multiplexor selects the signal groups */
+  for(sl = message->signal_list; sl != NULL; sl = sl->next) {
+    signalLayout_t *plan = &plans[nPlans];
+
+    if(signalLayout_init(plan, sl->signal)) {
+      if(plan->bigEndian) layout->needBE = 1;
+      else                layout->needLE = 1;
+      if((plan->base != 0) || plan->wide) layout->classic = 0;
+      if((muxSignal == NULL) && (sl->signal->mux_type == m_multiplexor)) {
+        muxSignal = sl->signal;
+      }
+      nPlans++;
+    } else {
+      fprintf(stderr,
+              "messageLayout_create(): signal %s of message %s exceeds "
+              "payload, ignored\n",
+              sl->signal->name, message->name);
+    }
+  }
+
+  /*
+   * order plans: signals present in every frame first, multiplexed
+   * signals behind. Without a multiplexor, all signals are decoded.
+   */
+  for(i = 0; i < nPlans; i++) {
+    if((muxSignal == NULL) || (plans[i].signal->mux_type != m_multiplexed)) {
+      if(plans[i].signal == muxSignal) layout->mux = &layout->signals[nBase];
+      layout->signals[nBase++] = plans[i];
+    }
+  }
+  layout->nSignals = nBase;
+  for(i = 0; i < nPlans; i++) {
+    if((muxSignal != NULL) && (plans[i].signal->mux_type == m_multiplexed)) {
+      layout->signals[layout->nSignals++] = plans[i];
+    }
+  }
+  free(plans);
+  plans = NULL;
+
+  signalGroup_init(&layout->base, layout->signals, nBase, 0);
+  if(messageLayout_buildGroups(layout, layout->signals + nBase,
+                               layout->nSignals - nBase)) {
+    goto fail;
+  }
+  return layout;
+
+fail:
+  fprintf(stderr, "messageLayout_create(): out of memory\n");
+  free(plans);
+  free(layout->muxTable);
+  free(layout->groups);
+  free(layout->signals);
+  free(layout);
+  return NULL;
+}
+
+/* free compiled message layout and its message */
+void messageLayout_free(messageLayout_t *layout)
+{
+  if(layout != NULL) {
+    free(layout->muxTable);
+    free(layout->groups);
+    free(layout->signals);
+    message_free(layout->message);
+    free(layout);
+  }
+}
+
+/* load payload in little endian byte order */
+static uint64_t payload_loadLE(const uint8 *b)
+{
+  return  (uint64_t)b[0]        | ((uint64_t)b[1] <<  8)
+       | ((uint64_t)b[2] << 16) | ((uint64_t)b[3] << 24)
+       | ((uint64_t)b[4] << 32) | ((uint64_t)b[5] << 40)
+       | ((uint64_t)b[6] << 48) | ((uint64_t)b[7] << 56);
+}
+
+/* load payload in big endian byte order */
+static uint64_t payload_loadBE(const uint8 *b)
+{
+  return ((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48)
+       | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32)
+       | ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16)
+       | ((uint64_t)b[6] <<  8) |  (uint64_t)b[7];
+}
+
+/*
+ * convert raw value to physical value and pass it to the callback
+ */
+static inline void signal_emit(const signalLayout_t *sl,
+                               uint64_t              rawValue,
+                               double                dtime,
+                               signalProcCb_t        signalProcCb,
+                               void                 *cbData)
+{
+  double physicalValue;
+
+  /*
+   * Factor, Offset and Physical Unit
+   *
+   * The "physical value" of a signal is the value of the physical
+   * quantity (e.g. speed, rpm, temperature, etc.) that represents
+   * the signal.
+   * The signal's conversion formula (Factor, Offset) is used to
+   * transform the raw value to a physical value or in the reverse
+   * direction.
+   * [Physical value] = ( [Raw value] * [Factor] ) + [Offset]
+   */
+  if(sl->isSigned) {
+    /* perform sign extension, 64 bit values are complete already */
+    if(sl->signBit) rawValue = (rawValue ^ sl->signBit) - sl->signBit;
+    physicalValue = (double)(int64_t)rawValue * sl->scale + sl->offset;
+  } else {
+    physicalValue = (double)rawValue * sl->scale + sl->offset;
+  }
+
+  /* invoke signal processing callback function */
+  signalProcCb(sl, dtime, rawValue, physicalValue, cbData);
+}
+
+/*
+ * extract raw value from a payload word starting at byte sl->base.
+ * Used for CAN FD frames and signals spanning 9 bytes.
+ */
+static inline uint64_t signalLayout_extract(const signalLayout_t *sl,
+                                            const uint8          *payload)
+{
+  const uint8 *b = payload + sl->base;
+  uint64_t rawValue;
+
+  if(sl->bigEndian) {
+    rawValue = payload_loadBE(b);
+    if(sl->wide) {
+      rawValue = (rawValue << (8 - sl->shift)) | (b[8] >> sl->shift);
+    } else {
+      rawValue >>= sl->shift;
+    }
+  } else {
+    rawValue = payload_loadLE(b) >> sl->shift;
+    if(sl->wide) rawValue |= (uint64_t)b[8] << (64 - sl->shift);
+  }
+  return rawValue & sl->mask;
+}
+
+/*
+ * decode all signals of a group
+ *
+ * A group is skipped if the received payload is too short for any
+ * of its signals, keeping the time columns of the group consistent.
+ * Classic layouts use the payload words loaded once per message.
+ */
+static inline void signalGroup_decode(const messageLayout_t *layout,
+                                      const signalGroup_t   *group,
+                                      const canMessage_t    *canMessage,
+                                      uint64_t               wordLE,
+                                      uint64_t               wordBE,
+                                      double                 dtime,
+                                      signalProcCb_t         signalProcCb,
+                                      void                  *cbData)
+{
+  const signalLayout_t *sl = group->signals;
+  const signalLayout_t *const sl_end = sl + group->nSignals;
+
+  if(canMessage->len < group->minLen) return;
+
+  if(layout->classic) {
+    for(; sl < sl_end; sl++) {
+      /*
+       * The "raw value" of a signal is the value as it is transmitted
+       * over the network.
+       */
+      uint64_t rawValue = ((sl->bigEndian ? wordBE : wordLE) >> sl->shift)
+                        & sl->mask;
+
+      signal_emit(sl, rawValue, dtime, signalProcCb, cbData);
+    }
+  } else {
+    for(; sl < sl_end; sl++) {
+      signal_emit(sl, signalLayout_extract(sl, canMessage->byte_arr),
+                  dtime, signalProcCb, cbData);
+    }
+  }
+}
+
+/* look up signal group selected by multiplexor value */
+static inline const signalGroup_t *
+messageLayout_findGroup(const messageLayout_t *layout, uint64_t muxValue)
+{
+  unsigned int lo = 0;
+  unsigned int hi = layout->nGroups;
+
+  if(layout->muxTable != NULL) {
+    return (muxValue < layout->nMuxTable) ? layout->muxTable[muxValue]
+                                          : NULL;
+  }
+  while(lo < hi) {
+    unsigned int mid = lo + (hi - lo) / 2;
+
+    if(layout->groups[mid].muxValue == muxValue) {
+      return &layout->groups[mid];
+    } else if(layout->groups[mid].muxValue < muxValue) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return NULL;
+}
+
+static inline void canMessage_decodeFrame(const messageLayout_t *layout,
+                                          const canMessage_t *canMessage,
+                                          sint32              timeResolution,
+                                          signalProcCb_t      signalProcCb,
+                                          void               *cbData)
+{
   uint32  sec = canMessage->t.tv_sec;
   sint32 nsec = canMessage->t.tv_nsec;
+  uint64_t wordLE = 0;
+  uint64_t wordBE = 0;
   double dtime;
 
   /* limit time resolution */
@@ -48,150 +490,61 @@ void canMessage_decode(message_t      *dbcMessage,
           canMessage->byte_arr[6], canMessage->byte_arr[7] );
 #endif
 
-  /* iterate over all signals */
-  for(sl = dbcMessage->signal_list; sl != NULL; sl = sl->next) {
-    /*
-     * The "raw value" of a signal is the value as it is transmitted
-     * over the network.
-     */
-    uint32 rawValue   = 0;
-
-    /*
-     * compute some signal properties
-     *
-     * signal bit order:
-     *
-     *     7  6  5  4  3  2  1  0 offset
-     *    bit
-     * 0   7  6  5  4  3  2  1  0
-     * 1  15 14 13 12 11 10  9  8
-     * 2  23 22 21 20 19 18 17 16
-     * 3  31 30 29 28 27 26 25 24
-     * 4  39 38 37 36 35 34 33 32
-     * 5  47 46 45 44 43 42 41 40
-     * 6  55 54 53 52 51 50 49 48
-     * 7  63 62 61 60 59 58 57 56
-     * |
-     * start_byte
-     *
-     * big endian place value exponent
-     *                15 14 13 12   <- start_byte
-     *    11 10  9  8  7  6  5  4
-     *     3  2  1  0               <- end_byte
-     *
-     * little endian place value exponent
-     *     3  2  1  0               <- start_byte
-     *    11 10  9  8  7  6  5  4
-     *                15 14 13 12   <- end_byte
-     */
-    const signal_t *const s = sl->signal;
-    uint8  bit_len      = s->bit_len;
-    uint8  start_offset = s->bit_start & 7;
-    uint8  start_byte   = s->bit_start / 8;
-    uint8  data;
-    sint8  work_byte;
-    uint8  shift;
-
-    /* align signal into ulong32 */
-    /* 0 = Big Endian, 1 = Little Endian */    
-    if(s->endianess == 0) { /* big endian */
-      uint8  end_byte     = start_byte + (7 + bit_len - start_offset - 1)/8;
-      uint8  end_offset   = (start_offset - bit_len + 1) & 7;
-
-      /* loop over all source bytes from start_byte to end_byte */
-      for(work_byte = start_byte; work_byte <= end_byte; work_byte++) {
-        /* fetch source byte */
-        data = canMessage->byte_arr[work_byte];
-
-        /* process source byte */
-        if(work_byte == start_byte && start_offset != 7) {
-          /* less that 8 bits in start byte? mask out unused bits */
-          data &= (uint8)~0 >> (7 - start_offset);
-          shift = start_offset + 1;
-        } else {
-          shift = 8; /* use all eight bits */
-        }
-        if(work_byte == end_byte && end_offset != 0) {
-          /* less that 8 bits in end byte? shift out unused bits */
-          data >>= end_offset;
-          shift -= end_offset;
-        }
-
-        /* store processed byte */
-        rawValue <<= shift; /* make room for shift bits */
-        rawValue |= data;   /* insert new bits at low position */
-      }
-    } else {
-      /* little endian - similar algorithm with reverse bit significance  */
-      uint8  end_byte     = start_byte + (bit_len + start_offset - 1)/8;
-      uint8  end_offset   = (start_offset + bit_len - 1) & 7;
-
-      for(work_byte = end_byte; work_byte >= start_byte; work_byte--) {
-        data = canMessage->byte_arr[work_byte];
-        if(work_byte == end_byte && end_offset != 7) {
-          data &= (uint8)~0 >> (7 - end_offset);
-          shift = end_offset + 1;
-        } else {
-          shift = 8;
-        }
-        if(work_byte == start_byte && start_offset != 0) {
-          data >>= start_offset;
-          shift -= start_offset;
-        }
-        rawValue <<= shift;
-        rawValue |= data;
-      }
-    }
+  /* load payload words once per message */
+  if(layout->classic) {
+    if(layout->needLE) wordLE = payload_loadLE(canMessage->byte_arr);
+    if(layout->needBE) wordBE = payload_loadBE(canMessage->byte_arr);
+  }
 
-    {
-      double physicalValue;
+  /* signals present in every frame */
+  signalGroup_decode(layout, &layout->base, canMessage, wordLE, wordBE,
+                     dtime, signalProcCb, cbData);
 
-      /* perform sign extension */
-      if(s->signedness && (bit_len < 32)) {
-        sint32 m = 1<< (bit_len-1);
-        rawValue = ((sint32)rawValue ^ m) - m;
-      }
+  /* signals selected by the multiplexor */
+  if((layout->mux != NULL) && (canMessage->len >= layout->mux->minLen)) {
+    const signalLayout_t *mux = layout->mux;
+    const signalGroup_t *group;
+    uint64_t muxValue;
 
-      /*
-       * Factor, Offset and Physical Unit
-       *
-       * The "physical value" of a signal is the value of the physical
-       * quantity (e.g. speed, rpm, temperature, etc.) that represents
-       * the signal.
-       * The signal's conversion formula (Factor, Offset) is used to
-       * transform the raw value to a physical value or in the reverse
-       * direction.
-       * [Physical value] = ( [Raw value] * [Factor] ) + [Offset]
-       */
-      if(s->signedness) {
-        physicalValue = (double)(sint32)rawValue
-          * s->scale + s->offset;
-      } else {
-        physicalValue = (double)        rawValue
-          * s->scale + s->offset;
-      }
+    if(layout->classic) {
+      muxValue = ((mux->bigEndian ? wordBE : wordLE) >> mux->shift)
+               & mux->mask;
+    } else {
+      muxValue = signalLayout_extract(mux, canMessage->byte_arr);
+    }
+    group = messageLayout_findGroup(layout, muxValue);
+    if(group != NULL) {
+      signalGroup_decode(layout, group, canMessage, wordLE, wordBE,
+                         dtime, signalProcCb, cbData);
+    }
+  }
+}
 
-#if 0
-      fprintf(stderr,"   %s\t=%f ~ raw=%ld\t~ %d|%d@%d%c (%f,%f)"
-             " [%f|%f] %d %ul \"%s\"\n",
-             outputSignalName,
-             physicalValue,
-             rawValue,
-             s->bit_start,
-             s->bit_len,
-             s->endianess,
-             s->signedness?'-':'+',
-             s->scale,
-             s->offset,
-             s->min,
-             s->max,
-             s->mux_type,
-             (unsigned int)s->mux_value,
-             s->comment!=NULL?s->comment:"");
-#endif
+void canMessage_decode(const messageLayout_t *layout,
+                       canMessage_t          *canMessage,
+                       sint32                 timeResolution,
+                       signalProcCb_t         signalProcCb,
+                       void                  *cbData)
+{
+  canMessage_decodeFrame(layout, canMessage, timeResolution,
+                         signalProcCb, cbData);
+}
 
-      /* invoke signal processing callback function */
-      signalProcCb(s, dtime, rawValue, physicalValue, cbData);
-    }
+/*
+ * decode n frames of the same message in one loop, so the layout
+ * and the time series of its signals stay in cache
+ */
+void canMessage_decodeBatch(const messageLayout_t *layout,
+                            canMessage_t *const   *canMessage,
+                            unsigned int           n,
+                            sint32                 timeResolution,
+                            signalProcCb_t         signalProcCb,
+                            void                  *cbData)
+{
+  unsigned int i;
+
+  for(i = 0; i < n; i++) {
+    canMessage_decodeFrame(layout, canMessage[i], timeResolution,
+                           signalProcCb, cbData);
   }
 }
@@ -0,0 +1,120 @@
+#ifndef INCLUDE_MESSAGEDECODER_H
+#define INCLUDE_MESSAGEDECODER_H
+
+/*  messagedecoder.h -- declarations for messagedecoder
+    Copyright (C) 2007-2017 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+#include "dbcmodel.h"
+#include "measurement.h"
+
+/*
+ * compiled extraction plan of a single signal
+ *
+ * Eight payload bytes starting at byte base are loaded into one 64
+ * bit word, either in little endian (Intel) or big endian (Motorola)
+ * byte order. The raw value is then obtained by a shift, a mask and
+ * an optional sign extension. Signals within the first 8 bytes use
+ * base 0, so classic frames need only one load per byte order.
+ *
+ * Long signals which are not byte aligned may span 9 bytes; these
+ * are marked wide and take the remaining bits from byte base + 8.
+ */
+typedef struct {
+  const signal_t *signal;     /* signal definition */
+  uint8_t         bigEndian;  /* 1: use big endian payload word */
+  uint8_t         wide;       /* 1: signal spans 9 bytes */
+  uint8_t         base;       /* first byte of payload word */
+  uint8_t         shift;      /* bit position of the LSB in payload word */
+  uint8_t         minLen;     /* payload length required by the signal */
+  uint8_t         isSigned;   /* 1: signed signal */
+  uint64_t        mask;       /* mask of bit_len bits */
+  uint64_t        signBit;    /* sign bit, 0 unless signed and < 64 bit */
+  double          scale;
+  double          offset;
+  unsigned int    slot;       /* time series slot of output signal */
+} signalLayout_t;
+
+/*
+ * group of signals decoded together
+ *
+ * A group is decoded completely or not at all, so all of its signals
+ * can share one time column.
+ */
+typedef struct {
+  uint32_t        muxValue;   /* multiplexor value selecting the group */
+  uint8_t         minLen;     /* payload length required by all signals */
+  unsigned int    timeColumn; /* shared time column of the group */
+  unsigned int    nSignals;
+  signalLayout_t *signals;    /* first plan of the group */
+} signalGroup_t;
+
+/*
+ * compiled message layout, built once per DBC message
+ *
+ * The signal plans are ordered by group: signals present in every
+ * frame (including the multiplexor) come first, followed by the
+ * multiplexed signals sorted by multiplexor value. The multiplexor
+ * selects a group either by a dense jump table or, for sparse
+ * multiplexor values, by binary search in the sorted groups.
+ */
+typedef struct messageLayout_s {
+  message_t      *message;    /* message definition (owned) */
+  uint8_t         needLE;     /* at least one Intel signal */
+  uint8_t         needBE;     /* at least one Motorola signal */
+  uint8_t         classic;    /* all signals use base 0 and are not wide */
+  uint8_t         exclusive;  /* no output signal shared with other layouts */
+  signalGroup_t   base;       /* signals present in every frame */
+  const signalLayout_t *mux;  /* multiplexor, NULL if not multiplexed */
+  unsigned int    nGroups;
+  signalGroup_t  *groups;     /* multiplexed groups, sorted by muxValue */
+  unsigned int    nMuxTable;
+  signalGroup_t **muxTable;   /* dense jump table, NULL if sparse */
+  unsigned int    nSignals;
+  signalLayout_t *signals;    /* array of nSignals plans */
+} messageLayout_t;
+
+/* signal processing callback function */
+typedef void (* signalProcCb_t)(const signalLayout_t *sl,
+                                double                dtime,
+                                uint64_t              rawValue,
+                                double                physicalValue,
+                                void                 *cbData);
+
+messageLayout_t *messageLayout_create(message_t *message);
+void messageLayout_free(messageLayout_t *layout);
+
+void canMessage_decode(const messageLayout_t *layout,
+                       canMessage_t          *canMessage,
+                       sint32                 timeResolution,
+                       signalProcCb_t         signalProcCb,
+                       void                  *cbData);
+void canMessage_decodeBatch(const messageLayout_t *layout,
+                            canMessage_t *const   *canMessage,
+                            unsigned int           n,
+                            sint32                 timeResolution,
+                            signalProcCb_t         signalProcCb,
+                            void                  *cbData);
+
+#endif
@@ -17,98 +17,131 @@
 #include "cantools_config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "dbcmodel.h"
 #include "messagehash.h"
-#include "hashtable.h"
-#include "hashtable_itr.h"
+#include "messagedecoder.h"
 
-/*
- * J1939 extended message decomposition
- * http://www.can-wiki.info/SaeJ1939
- */
-const uint32 mask_ext = 0x80000000UL;
-const uint32 mask_29  = 0x1FFFFFFFUL;
-const uint32 mask_11  = 0x000007FFUL;
-const uint32 mask_pri = 0x1C000000UL; /* Priority */
-const uint32 mask_pgn = 0x03FFFF00UL; /* Parameter Group Number */
-const uint32 mask_res = 0x02000000UL; /* Reserved */
-const uint32 mask_dp  = 0x01000000UL; /* Data Page */
-const uint32 mask_pf  = 0x00FF0000UL; /* PDU Format */
-const uint32 mask_ps  = 0x0000FF00UL; /* PDU Specific */
-const uint32 mask_sad = 0x000000FFUL; /* Source Address */
-
-/* hash function for canIDs */
-static unsigned int hash_from_canid(void *keyp)
+/* allocate open addressing table for n keys, load factor <= 1/2 */
+static int messageHashTable_init(messageHashTable_t *t, unsigned int n)
 {
-  const messageHashKey_t key = *(messageHashKey_t *)keyp;
-
-  //  printf("key = %lx, key & mask_ext = %lx, key & ~mask_11 = %lx\n",key, key&mask_ext, key&~mask_11);
-  if(key & mask_ext) {         /* ext bit set? */
-    //    printf("                      B\n");
-    return key & mask_pgn;
-  } else if(key & ~mask_11) {  /* 29 bit message? */
-    //    printf("                                           C\n");
-    return key & mask_pgn;
-  } else {
-    //    printf("  A\n");
-    return key;
-  }
+  unsigned int bits = 2;
+
+  t->shift = 0;
+  t->mask = 0;
+  t->slots = NULL;
+  if(n == 0) return 0;
+
+  while((1u << bits) < 2 * n) bits++;
+  t->slots = calloc((size_t)1 << bits, sizeof(*t->slots));
+  if(t->slots == NULL) return 1;
+  t->shift = 32 - bits;
+  t->mask = (1u << bits) - 1;
+  return 0;
 }
 
-static int canids_equal(void *key1p, void *key2p)
+/* insert or replace layout of key */
+static void messageHashTable_insert(messageHashTable_t *t,
+                                    messageHashKey_t key,
+                                    messageLayout_t *layout)
 {
-  const messageHashKey_t key1 = *(messageHashKey_t *)key1p;
-  const messageHashKey_t key2 = *(messageHashKey_t *)key2p;
-  int eq;
-
-  /* J1939 extended message? */
-  if((key1 & mask_ext) || (key2 & mask_ext)) {
-    /* mask out priority and source */
-    eq = ((key1 & mask_pgn) == (key2 & mask_pgn));
-  } else {
-    eq = (key1 == key2);
+  unsigned int i;
+
+  for(i = (uint32)(key * 0x9E3779B1UL) >> t->shift; ; i = (i + 1) & t->mask) {
+    messageHashSlot_t *slot = &t->slots[i];
+
+    if((slot->layout == NULL) || (slot->key == key)) {
+      slot->key = key;
+      slot->layout = layout;
+      return;
+    }
   }
-  return eq;
 }
 
-struct hashtable *messageHash_create(message_list_t *message_list)
+/*
+ * build CAN-ID index from DBC message list
+ *
+ * All layouts are compiled first, so the tables are sized once and
+ * need no per-entry allocation.
+ */
+messageHash_t *messageHash_create(message_list_t *message_list)
 {
-  struct hashtable *h;
-
-  h = create_hashtable(16, hash_from_canid, canids_equal);
+  message_list_t *ml;
+  unsigned int n = 0;
+  unsigned int nExact = 0;
+  unsigned int nPgn = 0;
+  unsigned int i;
+  messageHash_t *h = calloc(1, sizeof(*h));
+
+  if(h == NULL) goto fail;
+
+  for(ml = message_list; ml != NULL; ml = ml->next) n++;
+  h->layouts = (n > 0) ? malloc(n * sizeof(*h->layouts)) : NULL;
+  if((n > 0) && (h->layouts == NULL)) goto fail;
+
+  for(ml = message_list; ml != NULL; ml = ml->next) {
+    message_t *message = message_dup(ml->message);
+    messageLayout_t *layout;
+
+    /* compile message layout once, the layout owns the message copy */
+    layout = messageLayout_create(message);
+    if(layout == NULL) {
+      fprintf(stderr, "error: could not compile message %s.\n",
+              message->name);
+      message_free(message);
+      continue;
+    }
+    h->layouts[h->nLayouts++] = layout;
 
-  if(h != NULL) {
-    for(;
-        message_list != NULL;
-        message_list = message_list->next) {
-      message_t *message = message_dup(message_list->message);
-
-      /*
-       * id needs to be allocated, because hashtable_destroy wants to
-       * free it :(
-       */
-      messageHashKey_t *key = malloc(sizeof(messageHashKey_t));
-      *key = message->id;
-      hashtable_insert(h, key, message);
+    if(message->id & MESSAGEHASH_MASK_EXT) {
+      nPgn++;
+    } else if(message->id & ~MESSAGEHASH_MASK_11) {
+      nExact++;
     }
-  } else {
-    fprintf(stderr, "error: could not create message hash.\n");
   }
 
+  if(   messageHashTable_init(&h->exact, nExact)
+     || messageHashTable_init(&h->exactPgn, nExact)
+     || messageHashTable_init(&h->pgn, nPgn)) {
+    goto fail;
+  }
+
+  /* later entries of the message list replace earlier ones */
+  for(i = 0; i < h->nLayouts; i++) {
+    messageLayout_t *layout = h->layouts[i];
+    messageHashKey_t key = layout->message->id;
+
+    if(key & MESSAGEHASH_MASK_EXT) {
+      /* mask out priority and source */
+      messageHashTable_insert(&h->pgn, key & MESSAGEHASH_MASK_PGN, layout);
+    } else if(key & ~MESSAGEHASH_MASK_11) {
+      messageHashTable_insert(&h->exact, key, layout);
+      messageHashTable_insert(&h->exactPgn, key & MESSAGEHASH_MASK_PGN,
+                              layout);
+    } else {
+      h->std[key] = layout;
+    }
+  }
   return h;
+
+fail:
+  fprintf(stderr, "error: could not create message hash.\n");
+  messageHash_free(h);
+  return NULL;
 }
 
-void messageHash_free(struct hashtable *const h)
+void messageHash_free(messageHash_t *h)
 {
   if(h != NULL) {
-    if (hashtable_count(h) > 0) {
-      struct hashtable_itr *itr = hashtable_iterator(h);
-      do {
-        message_t *m = hashtable_iterator_value(itr);
-        message_free(m);
-      } while (hashtable_iterator_advance(itr));
-      free(itr);
+    unsigned int i;
+
+    for(i = 0; i < h->nLayouts; i++) {
+      messageLayout_free(h->layouts[i]);
     }
-    hashtable_destroy(h, 0);
+    free(h->layouts);
+    free(h->exact.slots);
+    free(h->exactPgn.slots);
+    free(h->pgn.slots);
+    free(h);
   }
 }
@@ -0,0 +1,120 @@
+#ifndef INCLUDE_MESSAGEHASH_H
+#define INCLUDE_MESSAGEHASH_H
+
+/*  messagehash.h -- declarations for messagehash
+    Copyright (C) 2007-2017 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stddef.h>
+
+#include "dbcmodel.h"
+
+/*
+ * J1939 extended message decomposition
+ * http://www.can-wiki.info/SaeJ1939
+ */
+#define MESSAGEHASH_MASK_EXT 0x80000000UL /* extended frame flag */
+#define MESSAGEHASH_MASK_29  0x1FFFFFFFUL
+#define MESSAGEHASH_MASK_11  0x000007FFUL
+#define MESSAGEHASH_MASK_PRI 0x1C000000UL /* Priority */
+#define MESSAGEHASH_MASK_PGN 0x03FFFF00UL /* Parameter Group Number */
+#define MESSAGEHASH_MASK_RES 0x02000000UL /* Reserved */
+#define MESSAGEHASH_MASK_DP  0x01000000UL /* Data Page */
+#define MESSAGEHASH_MASK_PF  0x00FF0000UL /* PDU Format */
+#define MESSAGEHASH_MASK_PS  0x0000FF00UL /* PDU Specific */
+#define MESSAGEHASH_MASK_SAD 0x000000FFUL /* Source Address */
+
+typedef uint32 messageHashKey_t;
+
+struct messageLayout_s;
+
+/* slot of an open addressing table, empty if layout is NULL */
+typedef struct {
+  messageHashKey_t        key;
+  struct messageLayout_s *layout;
+} messageHashSlot_t;
+
+/* open addressing table with linear probing */
+typedef struct {
+  unsigned int       shift; /* 32 - log2(number of slots) */
+  unsigned int       mask;  /* number of slots - 1 */
+  messageHashSlot_t *slots; /* NULL if the table is empty */
+} messageHashTable_t;
+
+/*
+ * CAN-ID index of the messages of one DBC file
+ *
+ * 11 bit identifiers index a direct array. Extended identifiers are
+ * stored by J1939 PGN, i.e. without priority and source address.
+ * Identifiers above 11 bits without the extended flag are matched
+ * exactly, and by PGN if the received frame is extended. If a DBC file
+ * defines an identifier twice, the later definition is found.
+ */
+typedef struct {
+  struct messageLayout_s  *std[MESSAGEHASH_MASK_11 + 1];
+  messageHashTable_t       exact; /* 29 bit identifiers, exact match */
+  messageHashTable_t       pgn;   /* extended identifiers by PGN */
+  messageHashTable_t       exactPgn; /* 29 bit identifiers by PGN */
+  unsigned int             nLayouts;
+  struct messageLayout_s **layouts; /* all compiled layouts, DBC order */
+} messageHash_t;
+
+messageHash_t *messageHash_create(message_list_t *message_list);
+void messageHash_free(messageHash_t *h);
+
+/* Fibonacci hashing, the table size selects the upper bits */
+static inline struct messageLayout_s *
+messageHashTable_search(const messageHashTable_t *t, messageHashKey_t key)
+{
+  unsigned int i;
+
+  if(t->slots == NULL) return NULL;
+  for(i = (uint32)(key * 0x9E3779B1UL) >> t->shift; ; i = (i + 1) & t->mask) {
+    const messageHashSlot_t *slot = &t->slots[i];
+
+    if(slot->layout == NULL) return NULL;
+    if(slot->key == key) return slot->layout;
+  }
+}
+
+/* look up compiled message layout of a received CAN-ID */
+static inline struct messageLayout_s *
+messageHash_search(const messageHash_t *h, messageHashKey_t key)
+{
+  struct messageLayout_s *layout;
+
+  if(key & MESSAGEHASH_MASK_EXT) {
+    layout = messageHashTable_search(&h->pgn, key & MESSAGEHASH_MASK_PGN);
+    if(layout == NULL) {
+      layout = messageHashTable_search(&h->exactPgn,
+                                       key & MESSAGEHASH_MASK_PGN);
+    }
+    return layout;
+  }
+  if(key <= MESSAGEHASH_MASK_11) {
+    return h->std[key];
+  }
+
+  /* 29 bit identifier without extended flag, e.g. from ASC files */
+  layout = messageHashTable_search(&h->exact, key);
+  if(layout == NULL) {
+    layout = messageHashTable_search(&h->pgn, key & MESSAGEHASH_MASK_PGN);
+  }
+  return layout;
+}
+
+#endif
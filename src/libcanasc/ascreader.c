@@ -19,8 +19,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
+#include <stdint.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+# include <unistd.h>
+#endif
 #include "ascreader.h"
+#include "textscan.h"
+#include "filemap.h"
 
 typedef enum {
   unset = 0,
@@ -28,170 +34,829 @@ typedef enum {
   hexadecimal = 16
 } numBase_t;
 
+/* read size of the stream parser */
+#define ASCREADER_CHUNK_SIZE (1024 * 1024)
+
+/* size of file sections parsed by worker threads */
+#define ASCREADER_SECTION_SIZE (2 * 1024 * 1024)
+
+/* number of parser threads, 0 selects the number of online CPUs */
+static unsigned int ascReader_threads = 0;
+
 /*
- * Parser for ASC files.
+ * Parser state
  *
- * fp       FILE pointer of input file
- * msgRxCb  callback function for received messages
- * cbData   pointer to opaque callback data
+ * The scanner works on a memory range holding complete lines. It never
+ * reads beyond end, the range needs no terminating NUL character.
  */
-void ascReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+typedef struct {
+  const char *p;      /* current position */
+  const char *end;    /* end of scanned range */
+  numBase_t numbase;  /* numeric base of CAN-IDs and data bytes */
+  int stop;           /* stop parsing, e.g. due to missing base */
+} ascScanner_t;
+
+/* value of digit characters plus one, 0 for other characters */
+static const uint8 ascScanner_digit[256] = {
+  ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+  ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+  ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+  ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+/* characters separating tokens of a line */
+static inline int ascScanner_isBlank(char c)
 {
-  char buffer[100];
-  char *cp;
-  numBase_t numbase = unset;
+  return (c == ' ') || (c == '\t') || (c == '\r');
+}
 
-  /* loop for reading input lines */
-  while(1) {
-    char *buffer_lasts; /* reentrancy structure for strtok on buffer */
-    char *bp;
-
-    bp = fgets(buffer,sizeof(buffer),fp);
-    if(feof(fp)) break;                          /* EOF... stop loop */
-    if(bp==NULL) break;
-    if ((cp = strstr(buffer, "\n\r")) != NULL) { /* remove line CR/NL */
-      *cp = '\0';
+/* skip blanks, stops at end of line */
+static inline void ascScanner_skipBlank(ascScanner_t *s)
+{
+  while((s->p < s->end) && ascScanner_isBlank(*s->p)) s->p++;
+}
+
+/*
+ * get next token of the current line
+ *
+ * returns the length of the token, 0 at end of line
+ */
+static inline size_t ascScanner_token(ascScanner_t *s, const char **token)
+{
+  const char *p;
+
+  ascScanner_skipBlank(s);
+  p = s->p;
+  while((p < s->end) && (*p != '\n') && !ascScanner_isBlank(*p)) p++;
+  *token = s->p;
+  s->p = p;
+  return (size_t)(p - *token);
+}
+
+/* advance to the start of the next line */
+static inline void ascScanner_nextLine(ascScanner_t *s)
+{
+  const char *nl = memchr(s->p, '\n', (size_t)(s->end - s->p));
+
+  s->p = (nl != NULL) ? nl + 1 : s->end;
+}
+
+/* compare token with a keyword */
+static inline int ascScanner_isWord(const char *token, size_t len,
+                                    const char *word)
+{
+  return (strlen(word) == len) && !memcmp(token, word, len);
+}
+
+/*
+ * convert leading digits of a token, like strtoul()
+ *
+ * Unlike strtoul(), conversion is limited to the token length and
+ * there is no sign or prefix handling.
+ */
+static inline uint32 ascScanner_number(const char *token, size_t len,
+                                       unsigned int base)
+{
+  uint32 value = 0;
+  size_t i;
+
+  for(i = 0; i < len; i++) {
+    unsigned int digit = ascScanner_digit[(uint8)token[i]] - 1u;
+
+    /* non-digits wrap around to UINT_MAX */
+    if(digit >= base) break;
+    value = value * base + digit;
+  }
+  return value;
+}
+
+/*
+ * parse time stamp with 1-9 decimal places, depending on the setting
+ * of the recording SW
+ */
+static inline int ascScanner_time(const ascScanner_t *s, const char *token,
+                                  canMessage_t *message)
+{
+  uint64_t sec;
+  uint32 nsec;
+
+  if(textScan_time(token, s->end, &sec, &nsec) != 0) return 0;
+  message->t.tv_sec  = (time_t)sec;
+  message->t.tv_nsec = nsec;
+  return 1;
+}
+
+/*
+ * compute numeric CAN-ID
+ *
+ * Different formats are possible based on the selection in the
+ * Options/Appearance menu:
+ *
+ * numeric  (Messages = ID)
+ * symbolic (Messages = Message name)
+ *
+ * decimal     (Number Formats = Decimal)
+ * hexadecimal (Number Formats = Hexadecimal)
+ *
+ * Symbolic mode is only partially supported. It will work only
+ * if the hexadecimal ID followed by a lowercaps 'h' is appended
+ * to the message name.
+ */
+static inline uint32 ascScanner_id(const char *token, size_t len,
+                                   numBase_t numbase)
+{
+  size_t i;
+
+  switch(token[len-1]) {
+  case 'h':
+    /* symbolic mode with hex hint after the last underscore */
+    for(i = len - 1; (i > 0) && (token[i-1] != '_'); i--);
+    return ascScanner_number(token + i, len - 1 - i, 16);
+  case 'x':
+    /* J1939 extended message IDs: remove node's source address */
+    return ascScanner_number(token, len - 1, numbase) & ~(uint32)0xFF;
+  default:
+    /* assume numeric mode */
+    return ascScanner_number(token, len, numbase);
+  }
+}
+
+/*
+ * parse data bytes up to the end of the line
+ *
+ * returns the number of bytes parsed
+ */
+static inline int ascScanner_bytes(ascScanner_t *s, uint8 *byte_arr,
+                                   int len)
+{
+  const char *token;
+  size_t tokenLen;
+  int i = 0;
+
+  /* fast path for runs of two digit hex bytes */
+  if(s->numbase == hexadecimal) {
+    ascScanner_skipBlank(s);
+    i = (int)textScan_hexPairs(s->p, s->end, byte_arr, (unsigned int)len,
+                               &s->p);
+  }
+
+  for(; i < len; i++) {
+    tokenLen = ascScanner_token(s, &token);
+    if(tokenLen == 0) break;
+    byte_arr[i] = (uint8)ascScanner_number(token, tokenLen, s->numbase);
+  }
+  return i;
+}
+
+/* check for single digit BRS/ESI flag of CAN FD lines */
+static inline int ascScanner_isFlag(const char *token, size_t len)
+{
+  return (len == 1) && ((token[0] == '0') || (token[0] == '1'));
+}
+
+/*
+ * CAN FD line, after bus keyword:
+ * CANFD <bus> <dir> <id> [<name>] <brs> <esi> <dlc> <len> <data>
+ */
+static int ascScanner_canFdFrame(ascScanner_t *s, canMessage_t *message)
+{
+  const char *token;
+  size_t len;
+  int dataLen;
+
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  message->bus = (uint8)ascScanner_number(token, len, 10);
+
+  if((len = ascScanner_token(s, &token)) < 2) return 0;
+  if((token[0] != 'R') || (token[1] != 'x')) return 0;
+
+  /* get message identifier */
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  message->id = ascScanner_id(token, len, s->numbase);
+
+  /* skip optional symbolic name */
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  if(!ascScanner_isFlag(token, len)) {
+    if((len = ascScanner_token(s, &token)) == 0) return 0;
+  }
+  message->flags = CANMESSAGE_FLAG_FD;
+  if(ascScanner_number(token, len, 10)) message->flags |= CANMESSAGE_FLAG_BRS;
+
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  if(ascScanner_number(token, len, 10)) message->flags |= CANMESSAGE_FLAG_ESI;
+
+  /* get DLC (always hexadecimal) and data length */
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  message->dlc = (uint8)ascScanner_number(token, len, 16);
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  dataLen = (int)ascScanner_number(token, len, 10);
+  if(dataLen > CANMESSAGE_MAX_LEN) dataLen = CANMESSAGE_MAX_LEN;
+
+  message->len = (uint8)ascScanner_bytes(s, message->byte_arr, dataLen);
+  return 1;
+}
+
+/*
+ * classic CAN line, after bus number:
+ * <id> Rx d <dlc> <data>
+ */
+static int ascScanner_canFrame(ascScanner_t *s, canMessage_t *message)
+{
+  const char *token;
+  size_t len;
+
+  message->flags = 0;
+
+  /* get message identifier */
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  message->id = ascScanner_id(token, len, s->numbase);
+
+  if((len = ascScanner_token(s, &token)) < 2) return 0;
+  if((token[0] != 'R') || (token[1] != 'x')) return 0;
+
+  /* data frame marker */
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+
+  /* get DLC */
+  if((len = ascScanner_token(s, &token)) == 0) return 0;
+  message->dlc = (uint8)ascScanner_number(token, len, 10);
+
+  message->len = (uint8)ascScanner_bytes(s, message->byte_arr,
+                           canMessage_dlcToLen(message->dlc, 0));
+  return 1;
+}
+
+/*
+ * parse one line, the scanner is left at the start of the next line
+ */
+static void ascScanner_line(ascScanner_t *s, msgBatch_t *batch)
+{
+  const char *token;
+  size_t len;
+
+  len = ascScanner_token(s, &token);
+  if(len == 0) {
+    ;                                            /* skip empty line */
+  } else if(ascScanner_isWord(token, len, "date")) {
+    ;                                            /* skip date info */
+  } else if(ascScanner_isWord(token, len, "base")) {
+    len = ascScanner_token(s, &token);           /* dec/hex */
+    if(ascScanner_isWord(token, len, "dec")) {
+      s->numbase = decimal;
+    } else if(ascScanner_isWord(token, len, "hex")) {
+      s->numbase = hexadecimal;
+    } else {
+      fprintf(stderr,
+              "ascReader_processFile(): unknown numeric base %.*s\n",
+              (int)len, token);
     }
-    cp = strtok_r (buffer," ", &buffer_lasts);   /* get first token */
-    if(!strcmp(cp,"date")) {
-      ;                                          /* skip date info */
-    } else if(!strcmp(cp,"base")) {              /* parse numeric base */
-      cp = strtok_r(NULL," ", &buffer_lasts);    /* dec/hex */
-      if(!strcmp(cp,"dec")) {
-        numbase = decimal;
-      } else if(!strcmp(cp,"hex")) {
-        numbase = hexadecimal;
+  } else if(ascScanner_isWord(token, len, "internal")
+         || ascScanner_isWord(token, len, "Begin")
+         || ascScanner_isWord(token, len, "Start")
+         || ((len >= 2) && (token[0] == '/') && (token[1] == '/'))) {
+    ;                                            /* skip comments */
+  } else if(s->numbase == unset) {
+    fprintf(stderr,"ascReader_processFile(): missing numeric base\n");
+    s->stop = 1;
+    return;
+  } else {
+    canMessage_t *message = msgBatch_next(batch);
+    int valid;
+
+    if(ascScanner_time(s, token, message)) {
+      /* get bus number */
+      len = ascScanner_token(s, &token);
+      if(ascScanner_isWord(token, len, "CANFD")) {
+        valid = ascScanner_canFdFrame(s, message);
+      } else if(len > 0) {
+        message->bus = (uint8)ascScanner_number(token, len, 10);
+        valid = ascScanner_canFrame(s, message);
       } else {
-        fprintf(stderr,
-                "ascReader_processFile(): unknown numeric base %s\n",
-                cp);
+        valid = 0;
       }
-      continue;
-    } else if(!strcmp(cp,"internal")) {
-      continue;
-    } else if(!strcmp(cp,"Begin")) {
-      continue;
-    } else if(!strcmp(cp,"Start")) {
-      continue;
+
+      /* append message to batch */
+      if(valid) msgBatch_commit(batch);
+    }
+  }
+  ascScanner_nextLine(s);
+}
+
+/* parse complete lines of a memory range until the batch is full */
+static void ascScanner_parse(ascScanner_t *s, msgBatch_t *batch)
+{
+  while((s->p < s->end) && !s->stop && !msgBatch_full(batch)) {
+    ascScanner_line(s, batch);
+  }
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * Parallel parsing of memory-mapped files
+ *
+ * After the header, the mapping is divided into sections of
+ * ASCREADER_SECTION_SIZE bytes, each extended to the end of its last
+ * line. Worker threads parse the sections into per-section message
+ * buffers; the reader hands over the buffers in file order.
+ * A section buffer is reused once its messages have been delivered,
+ * this limits memory to a few sections per thread.
+ */
+
+/* messages of a section */
+typedef struct {
+  canMessage_t *message;  /* parsed messages */
+  unsigned int  n;        /* number of messages */
+  unsigned int  size;     /* allocated entries */
+  size_t        section;  /* section index */
+  int           done;     /* section parsed */
+  int           failed;   /* out of memory */
+  msgBatch_t    batch;    /* batch filling the buffer */
+} ascSection_t;
+
+typedef struct {
+  const char     *begin;    /* start of first section */
+  const char     *end;      /* end of mapping */
+  numBase_t       numbase;  /* numeric base from header */
+  size_t          nSections;
+  size_t          next;     /* next section to be parsed */
+  size_t          delivered;/* number of delivered sections */
+  unsigned int    k;        /* delivered messages of next section */
+  int             stop;     /* abort workers */
+  unsigned int    nBuffers;
+  ascSection_t   *buffer;   /* section buffers, used round robin */
+  unsigned int    nStarted; /* number of started workers */
+  pthread_t      *thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t  parsed;   /* a section has been parsed */
+  pthread_cond_t  released; /* a section buffer has been released */
+} ascParallel_t;
+
+/* start of section: first line starting in the section */
+static const char *ascParallel_sectionStart(const ascParallel_t *ctx,
+                                            size_t section)
+{
+  const char *p, *nl;
+
+  if(section == 0) return ctx->begin;
+  if(section >= ctx->nSections) return ctx->end;
+  p = ctx->begin + section * ASCREADER_SECTION_SIZE - 1;
+  nl = memchr(p, '\n', (size_t)(ctx->end - p));
+  return (nl != NULL) ? nl + 1 : ctx->end;
+}
+
+/*
+ * batch callback of the workers: keep the filled entries and continue
+ * filling the buffer behind them
+ */
+static void ascSection_batchCb(canMessage_t *message, unsigned int n,
+                               void *cbData)
+{
+  ascSection_t *sec = (ascSection_t *)cbData;
+
+  sec->n += n;
+  if(sec->n + MSGBATCH_SIZE > sec->size) {
+    unsigned int size = 2 * sec->size;
+    canMessage_t *p = realloc(sec->message, size * sizeof(*p));
+
+    if(p == NULL) {
+      /* stop parsing, keep the messages of the full buffer */
+      sec->failed = 1;
     } else {
-      canMessage_t message;
+      sec->message = p;
+      sec->size = size;
+    }
+  }
+  sec->batch.message = sec->message + sec->n;
+}
 
-      char   *id_str;  /* symbolic CAN-ID */
-      char   *rx;
-      char   *d;
-      int     i;
+static void *ascParallel_worker(void *arg)
+{
+  ascParallel_t *ctx = (ascParallel_t *)arg;
 
-      if(numbase == unset) {
-        fprintf(stderr,"ascReader_processFile(): missing numeric base\n");
-        break;
-      }
+  pthread_mutex_lock(&ctx->mutex);
+  while(1) {
+    size_t section;
+    ascSection_t *sec;
+    ascScanner_t scanner;
 
-      /* parse line */
-
-      /*
-       * timestamps: the fractional part has 1-9 decimal places,
-       * depending on the setting of the recording SW.
-       */
-      char *tp;
-      char *time_lasts;
-      tp = strtok_r(cp, ".", &time_lasts); if(tp == NULL) continue;
-
-      message.t.tv_sec = 0;
-      message.t.tv_nsec = 0;
-      message.t.tv_sec = atoi(tp);
-
-      tp = strtok_r(NULL, " ", &time_lasts); if(tp == NULL) continue;
-      {
-        int i;
-        for(i = 0; i < 9; i++) {
-          message.t.tv_nsec *= 10;
-          if(isdigit(*tp)) {
-            message.t.tv_nsec += (*tp) - '0';
-            tp++;
-          }
-        }
-      }
+    /* wait for a free buffer */
+    while(!ctx->stop && (ctx->next < ctx->nSections)
+          && (ctx->next - ctx->delivered >= ctx->nBuffers)) {
+      pthread_cond_wait(&ctx->released, &ctx->mutex);
+    }
+    if(ctx->stop || (ctx->next >= ctx->nSections)) break;
+    section = ctx->next++;
+    sec = &ctx->buffer[section % ctx->nBuffers];
+    pthread_mutex_unlock(&ctx->mutex);
 
-      /* remove trailing newline */
-      cp = strtok_r(NULL, "\n", &buffer_lasts); if(cp == NULL) continue;
+    /* parse section */
+    memset(&scanner, 0, sizeof(scanner));
+    scanner.numbase = ctx->numbase;
+    scanner.p   = ascParallel_sectionStart(ctx, section);
+    scanner.end = ascParallel_sectionStart(ctx, section + 1);
+    sec->n = 0;
+    sec->failed = 0;
+    msgBatch_init(&sec->batch, sec->message, MSGBATCH_SIZE,
+                  ascSection_batchCb, sec);
+    while((scanner.p < scanner.end) && !sec->failed) {
+      ascScanner_line(&scanner, &sec->batch);
+    }
+    msgBatch_flush(&sec->batch);
 
-      /* get bus number */
-      cp = strtok_r(cp, " ", &buffer_lasts); if(cp == NULL) continue;
-      message.bus = atoi(cp);
+    pthread_mutex_lock(&ctx->mutex);
+    sec->section = section;
+    sec->done = 1;
+    pthread_cond_broadcast(&ctx->parsed);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+  return NULL;
+}
+
+/* number of parser threads to use */
+static unsigned int ascParallel_threads(void)
+{
+  long n = ascReader_threads;
+
+#ifdef _SC_NPROCESSORS_ONLN
+  if(n == 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return (n > 0) ? (unsigned int)n : 1;
+}
+
+/* stop workers and free parser */
+static void ascParallel_free(ascParallel_t *ctx)
+{
+  unsigned int i;
+
+  if(ctx->nStarted > 0) {
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->stop = 1;
+    pthread_cond_broadcast(&ctx->released);
+    pthread_mutex_unlock(&ctx->mutex);
+    for(i = 0; i < ctx->nStarted; i++) pthread_join(ctx->thread[i], NULL);
+  }
+  pthread_cond_destroy(&ctx->released);
+  pthread_cond_destroy(&ctx->parsed);
+  pthread_mutex_destroy(&ctx->mutex);
+  if(ctx->buffer != NULL) {
+    for(i = 0; i < ctx->nBuffers; i++) free(ctx->buffer[i].message);
+    free(ctx->buffer);
+  }
+  free(ctx->thread);
+  free(ctx);
+}
+
+/*
+ * start parsing the complete lines of the scanner range on worker
+ * threads, the scanner is advanced to the end of the range
+ *
+ * returns NULL if no worker could be started
+ */
+static ascParallel_t *ascParallel_start(ascScanner_t *s,
+                                        unsigned int nThreads)
+{
+  ascParallel_t *ctx = calloc(1, sizeof(*ctx));
+  unsigned int i;
 
-      /* get message identifier */
-      cp = strtok_r(NULL, " ", &buffer_lasts); if(cp == NULL) continue;
-      id_str = cp;
+  if(ctx == NULL) return NULL;
+  ctx->begin     = s->p;
+  ctx->end       = s->end;
+  ctx->numbase   = s->numbase;
+  ctx->nSections = ((size_t)(s->end - s->p) + ASCREADER_SECTION_SIZE - 1)
+                 / ASCREADER_SECTION_SIZE;
+  ctx->nBuffers  = 2 * nThreads;
+  pthread_mutex_init(&ctx->mutex, NULL);
+  pthread_cond_init(&ctx->parsed, NULL);
+  pthread_cond_init(&ctx->released, NULL);
 
-      cp = strtok_r(NULL, " ", &buffer_lasts); if(cp == NULL) continue;
-      rx = cp;
-      if((rx[0] != 'R') || (rx[1] != 'x')) continue;
+  ctx->thread = malloc(nThreads * sizeof(*ctx->thread));
+  ctx->buffer = calloc(ctx->nBuffers, sizeof(*ctx->buffer));
+  if((ctx->thread == NULL) || (ctx->buffer == NULL)) goto fail;
+  for(i = 0; i < ctx->nBuffers; i++) {
+    ctx->buffer[i].size = 4 * MSGBATCH_SIZE;
+    ctx->buffer[i].message = malloc(ctx->buffer[i].size
+                                    * sizeof(*ctx->buffer[i].message));
+    if(ctx->buffer[i].message == NULL) goto fail;
+  }
+
+  /* the workers only read the resolved scanner level */
+  textScan_getLevel();
+  for(ctx->nStarted = 0; ctx->nStarted < nThreads; ctx->nStarted++) {
+    if(pthread_create(&ctx->thread[ctx->nStarted], NULL,
+                      ascParallel_worker, ctx) != 0) break;
+  }
+  if(ctx->nStarted == 0) goto fail;
+  s->p = s->end;
+  return ctx;
 
-      cp = strtok_r(NULL, " ", &buffer_lasts); if(cp == NULL) continue;
-      d = cp;
+fail:
+  ascParallel_free(ctx);
+  return NULL;
+}
 
-      /* get DLC */
-      cp = strtok_r(NULL, " ", &buffer_lasts); if(cp == NULL) continue;
-      message.dlc = atoi(cp);
+/* hand over parsed messages in file order until the batch is full */
+static void ascParallel_next(ascParallel_t *ctx, msgBatch_t *batch)
+{
+  while(!msgBatch_full(batch) && (ctx->delivered < ctx->nSections)) {
+    ascSection_t *sec = &ctx->buffer[ctx->delivered % ctx->nBuffers];
+    unsigned int n;
 
-      /* get message bytes */
-      for(i = 0; i < message.dlc; i++) {
-        cp = strtok_r(NULL, " ", &buffer_lasts); if(cp == NULL) break;
-        message.byte_arr[i] = (uint8)strtoul(cp,NULL,numbase);
+    if(ctx->k == 0) {
+      pthread_mutex_lock(&ctx->mutex);
+      while(!sec->done || (sec->section != ctx->delivered)) {
+        pthread_cond_wait(&ctx->parsed, &ctx->mutex);
       }
+      pthread_mutex_unlock(&ctx->mutex);
 
-      /*
-       * compute numeric CAN-ID
-       *
-       * Different formats are possible based on the selection in the
-       * Options/Appearance menu:
-       *
-       * numeric  (Messages = ID)
-       * symbolic (Messages = Message name)
-       *
-       * decimal     (Number Formats = Decimal)
-       * hexadecimal (Number Formats = Hexadecimal)
-       *
-       * Symbolic mode is only partially supported. It will work only
-       * if the hexadecimal ID followed by a lowercaps 'h' is appended
-       * to the message name.
-       */
-      {
-        int len = strlen(id_str);
-        if(len == 0) break;
-
-        switch(id_str[len-1]) {
-        case 'h':
-          /* symbolic mode with hex hint */
-          {
-            char *cp;
-            char *id_lasts;
-
-            strtok_r(id_str,"_", &id_lasts);
-            cp = strtok_r(NULL, "h", &id_lasts);
-
-            /* force hex mode for id string */
-            message.id = (uint32)strtol(cp,NULL,16);
-          }
-          break;
-        case 'x':
-          /* J1939 extended message IDs */
-          message.id = (uint32)strtol(id_str,NULL,numbase);
-          /* remove node's source address */
-          message.id &= ~0xFF;
-          break;
-        default:
-          /* assume numeric mode */
-          message.id = (uint32)strtol(id_str,NULL,numbase);
-          break;
-        }
+      if(sec->failed) {
+        fprintf(stderr, "ascReader_nextBatch(): can't grow buffer\n");
       }
+    }
+
+    n = sec->n - ctx->k;
+    if(n > batch->size - batch->n) n = batch->size - batch->n;
+    memcpy(batch->message + batch->n, sec->message + ctx->k,
+           n * sizeof(*sec->message));
+    batch->n += n;
+    ctx->k += n;
+
+    /* release buffer */
+    if(ctx->k == sec->n) {
+      pthread_mutex_lock(&ctx->mutex);
+      sec->done = 0;
+      ctx->delivered++;
+      ctx->k = 0;
+      pthread_cond_broadcast(&ctx->released);
+      pthread_mutex_unlock(&ctx->mutex);
+    }
+  }
+}
+#endif
+
+/* reader state */
+struct ascReader_s {
+  FILE          *fp;
+  ascScanner_t   scanner;
+  void          *map;      /* memory mapping, NULL for streams */
+  size_t         mapSize;
+  char          *buffer;   /* chunk buffer of streams */
+  size_t         size;     /* allocated bytes of buffer */
+  size_t         fill;     /* bytes in buffer */
+  int            eof;      /* all input is in the scanner range */
+#ifdef HAVE_PTHREAD
+  ascParallel_t *parallel; /* worker threads, NULL for serial parsing */
+#endif
+};
+
+#ifdef HAVE_MMAP
+/*
+ * map regular file, large files are parsed on worker threads
+ *
+ * returns 0 on success, -1 if the file can't be mapped
+ */
+static int ascReader_openMapped(ascReader_t *r)
+{
+  ascScanner_t *s = &r->scanner;
+  size_t size;
+  void *map;
+
+  map = fileMap_open(fileno(r->fp), &size);
+  if(map == NULL) return -1;
+  r->map = map;
+  r->mapSize = size;
+  r->eof = 1;
+
+  s->p   = (const char *)map;
+  s->end = (const char *)map + size;
+
+#ifdef HAVE_PTHREAD
+  {
+    unsigned int nThreads = ascParallel_threads();
+    canMessage_t message;
+    msgBatch_t batch;
+
+    /* parse header up to the numeric base, it holds no messages */
+    msgBatch_init(&batch, &message, 1, NULL, NULL);
+    while((s->p < s->end) && !s->stop && (s->numbase == unset)) {
+      ascScanner_line(s, &batch);
+    }
+    if((nThreads > 1) && !s->stop
+       && ((size_t)(s->end - s->p) > 2 * ASCREADER_SECTION_SIZE)) {
+      r->parallel = ascParallel_start(s, nThreads);
+    }
+  }
+#endif
+  return 0;
+}
+#endif
+
+/*
+ * read next chunk of a stream, e.g. a pipe, after all complete lines
+ * of the previous chunk have been parsed
+ *
+ * The chunk buffer grows if a line does not fit.
+ *
+ * returns 0 on error
+ */
+static int ascReader_read(ascReader_t *r)
+{
+  ascScanner_t *s = &r->scanner;
+  const char *last;
+  size_t n;
+
+  /* keep the incomplete rest */
+  r->fill -= (size_t)(s->end - r->buffer);
+  memmove(r->buffer, s->end, r->fill);
+  if(r->fill == r->size) {
+    char *newBuffer = realloc(r->buffer, 2 * r->size);
+
+    if(newBuffer == NULL) {
+      fprintf(stderr, "ascReader_nextBatch(): can't grow buffer\n");
+      return 0;
+    }
+    r->buffer = newBuffer;
+    r->size *= 2;
+  }
+  n = fread(r->buffer + r->fill, 1, r->size - r->fill, r->fp);
+  r->fill += n;
+  s->p = r->buffer;
+
+  if(n == 0) {
+    /* last line without newline */
+    s->end = r->buffer + r->fill;
+    r->eof = 1;
+    return 1;
+  }
+
+  /* parse complete lines */
+  for(last = r->buffer + r->fill; last > r->buffer; last--) {
+    if(last[-1] == '\n') break;
+  }
+  s->end = last;
+  return 1;
+}
+
+/*
+ * open ASC file for reading batches of messages
+ *
+ * Regular files are parsed in place from a read-only memory mapping,
+ * other input, e.g. from a pipe, is read in chunks. There is no limit
+ * on the line length. Large mapped files are parsed on several
+ * threads, see ascReader_setThreads().
+ *
+ * fp       FILE pointer of input file, closed by ascReader_close() or
+ *          on error
+ *
+ * returns NULL on error
+ */
+ascReader_t *ascReader_open(FILE *fp)
+{
+  ascReader_t *r = calloc(1, sizeof(*r));
 
-      /* invoke message receive callback function */
-      msgRxCb(&message, cbData);
+  if(r == NULL) {
+    fprintf(stderr, "ascReader_open(): out of memory\n");
+    fclose(fp);
+    return NULL;
+  }
+  r->fp = fp;
+  r->scanner.numbase = unset;
+
+#ifdef HAVE_MMAP
+  if(ascReader_openMapped(r) != 0)
+#endif
+  {
+    r->size = ASCREADER_CHUNK_SIZE;
+    r->buffer = malloc(r->size);
+    if(r->buffer == NULL) {
+      fprintf(stderr, "ascReader_open(): can't allocate buffer\n");
+      ascReader_close(r);
+      return NULL;
     }
+    r->scanner.p = r->scanner.end = r->buffer;
+  }
+  return r;
+}
+
+/*
+ * parse next messages
+ *
+ * message  caller-provided array of size entries
+ *
+ * returns the number of messages, 0 at end of file
+ */
+unsigned int ascReader_nextBatch(ascReader_t *r, canMessage_t *message,
+                                 unsigned int size)
+{
+  ascScanner_t *s = &r->scanner;
+  msgBatch_t batch;
+
+  msgBatch_init(&batch, message, size, NULL, NULL);
+#ifdef HAVE_PTHREAD
+  if(r->parallel != NULL) {
+    ascParallel_next(r->parallel, &batch);
+    return batch.n;
+  }
+#endif
+  while(1) {
+    ascScanner_parse(s, &batch);
+    if(msgBatch_full(&batch) || s->stop || r->eof) break;
+    if(!ascReader_read(r)) break;
   }
+  return batch.n;
+}
+
+/* close input file and free reader */
+void ascReader_close(ascReader_t *r)
+{
+#ifdef HAVE_PTHREAD
+  if(r->parallel != NULL) ascParallel_free(r->parallel);
+#endif
+#ifdef HAVE_MMAP
+  if(r->map != NULL) munmap(r->map, r->mapSize);
+#endif
+  free(r->buffer);
+  fclose(r->fp);
+  free(r);
+}
+
+/*
+ * set number of parser threads for memory-mapped files
+ *
+ * n        number of threads, 0 selects the number of online CPUs
+ */
+void ascReader_setThreads(unsigned int n)
+{
+  ascReader_threads = n;
+}
+
+/*
+ * check for ASC header keywords
+ *
+ * The first non-empty line of an ASC file starts with one of the
+ * header keywords or a comment, a UTF-8 byte order mark is skipped.
+ *
+ * head     first n bytes of the file
+ *
+ * returns 1 for ASC files, 0 otherwise
+ */
+int ascReader_probe(const void *head, size_t n)
+{
+  static const char *const keyword[] = {
+    "date", "base", "internal", "Begin", "Start"
+  };
+  ascScanner_t s;
+  const char *token;
+  size_t len, i;
+
+  memset(&s, 0, sizeof(s));
+  s.p = (const char *)head;
+  s.end = s.p + n;
+  if((n >= 3) && !memcmp(s.p, "\xef\xbb\xbf", 3)) s.p += 3;
+
+  /* skip empty lines */
+  while((len = ascScanner_token(&s, &token)) == 0) {
+    if(s.p == s.end) return 0;
+    ascScanner_nextLine(&s);
+  }
+  for(i = 0; i < sizeof(keyword) / sizeof(keyword[0]); i++) {
+    if(ascScanner_isWord(token, len, keyword[i])) return 1;
+  }
+  return (len >= 2) && (token[0] == '/') && (token[1] == '/');
+}
+
+/*
+ * Parser for ASC files.
+ *
+ * fp       FILE pointer of input file
+ * batch    batch of received messages, flushed at end of file
+ */
+void ascReader_processFileBatch(FILE *fp, msgBatch_t *batch)
+{
+  ascReader_t *r = ascReader_open(fp);
+
+  if(r != NULL) {
+    while((batch->n = ascReader_nextBatch(r, batch->message,
+                                          batch->size)) > 0) {
+      msgBatch_flush(batch);
+    }
+    ascReader_close(r);
+  }
+}
+
+/*
+ * Parser for ASC files, per-message interface.
+ *
+ * fp       FILE pointer of input file
+ * msgRxCb  callback function for received messages
+ * cbData   pointer to opaque callback data
+ */
+void ascReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+{
+  canMessage_t message[MSGBATCH_ADAPTER_SIZE];
+  msgRxAdapter_t adapter = { msgRxCb, cbData };
+  msgBatch_t batch;
 
-  /* close input file stream */
-  fclose(fp);
+  msgBatch_init(&batch, message, MSGBATCH_ADAPTER_SIZE,
+                msgRxAdapter_batchCb, &adapter);
+  ascReader_processFileBatch(fp, &batch);
 }
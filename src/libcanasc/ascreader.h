@@ -28,7 +28,18 @@
 extern "C" {
 #endif
 
+/* pull-based reader */
+typedef struct ascReader_s ascReader_t;
+
+ascReader_t *ascReader_open(FILE *fp);
+unsigned int ascReader_nextBatch(ascReader_t *r, canMessage_t *message,
+                                 unsigned int size);
+void         ascReader_close(ascReader_t *r);
+
+int  ascReader_probe(const void *head, size_t n);
+void ascReader_processFileBatch(FILE *fp, msgBatch_t *batch);
 void ascReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData);
+void ascReader_setThreads(unsigned int n);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,376 @@
+/*  textscan.c -- text trace scanning kernels
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <string.h>
+#include "textscan.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define TEXTSCAN_SSE2 1
+#endif
+
+/* AVX2 code is compiled for the target attribute, selected at run time */
+#if defined(TEXTSCAN_SSE2) && (defined(__clang__) || (defined(__GNUC__) \
+    && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))))
+# include <immintrin.h>
+# define TEXTSCAN_AVX2 1
+#endif
+
+/* highest level permitted by textScan_setLevel() */
+static textScanLevel_t textScan_maxLevel = textScan_avx2;
+
+/* level in use, -1 until resolved by textScan_getLevel() */
+static int textScan_activeLevel = -1;
+
+/* value of hex digits plus one, 0 for other characters */
+static const uint8 textScan_hexDigit[256] = {
+  ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+  ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+  ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+  ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+/* instruction set level supported by the CPU */
+static textScanLevel_t textScan_cpuLevel(void)
+{
+#ifdef TEXTSCAN_AVX2
+  if(__builtin_cpu_supports("avx2")) return textScan_avx2;
+#endif
+#ifdef TEXTSCAN_SSE2
+  return textScan_sse2;
+#else
+  return textScan_scalar;
+#endif
+}
+
+textScanLevel_t textScan_setLevel(textScanLevel_t level)
+{
+  textScan_maxLevel = level;
+  textScan_activeLevel = -1;
+  return textScan_getLevel();
+}
+
+textScanLevel_t textScan_getLevel(void)
+{
+  if(textScan_activeLevel < 0) {
+    textScanLevel_t cpuLevel = textScan_cpuLevel();
+
+    textScan_activeLevel = (textScan_maxLevel < cpuLevel)
+                         ? textScan_maxLevel : cpuLevel;
+  }
+  return (textScanLevel_t)textScan_activeLevel;
+}
+
+/* level for dispatch, the CPU is only queried on first use */
+static inline textScanLevel_t textScan_level(void)
+{
+  if(textScan_activeLevel < 0) return textScan_getLevel();
+  return (textScanLevel_t)textScan_activeLevel;
+}
+
+/*
+ * hex pairs
+ */
+unsigned int textScan_hexPairsScalar(const char *p, const char *end,
+                                     uint8 *byte_arr, unsigned int max,
+                                     const char **next)
+{
+  unsigned int n;
+
+  for(n = 0; (n < max) && (end - p >= 3); n++, p += 3) {
+    unsigned int hi = textScan_hexDigit[(uint8)p[0]];
+    unsigned int lo = textScan_hexDigit[(uint8)p[1]];
+
+    if((hi == 0) || (lo == 0) || (p[2] != ' ')) break;
+    byte_arr[n] = (uint8)(((hi - 1) << 4) | (lo - 1));
+  }
+  *next = p;
+  return n;
+}
+
+#ifdef TEXTSCAN_SSE2
+/*
+ * Each 16 byte vector holds 5 pairs "hh hh hh hh hh ", i.e. pairs at
+ * offsets 0, 3, 6, 9 and 12. The masks select the digits and blanks of
+ * the pairs.
+ */
+#define TEXTSCAN_DIGIT_MASK 0x36DBu /* offsets 0,1,3,4,6,7,9,10,12,13 */
+#define TEXTSCAN_BLANK_MASK 0x4924u /* offsets 2,5,8,11,14 */
+
+/* number of leading valid pairs of a vector, given its bad offsets */
+static inline unsigned int textScan_validPairs(unsigned int bad)
+{
+  return bad ? (unsigned int)__builtin_ctz(bad) / 3 : 5;
+}
+
+/*
+ * convert hex digits of a vector to nibbles
+ *
+ * returns nibble vector, *digits is the mask of hex digits
+ */
+static inline __m128i textScan_nibbles(__m128i v, unsigned int *digits)
+{
+  const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+  const __m128i a = _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10));
+
+  /* signed compares on offsets, characters >= 0x80 are negative */
+  const __m128i isDigit = _mm_and_si128(
+    _mm_cmpgt_epi8(d, _mm_set1_epi8(-1)),
+    _mm_cmplt_epi8(d, _mm_set1_epi8(10)));
+  const __m128i isAlpha = _mm_and_si128(
+    _mm_cmpgt_epi8(a, _mm_set1_epi8(9)),
+    _mm_cmplt_epi8(a, _mm_set1_epi8(16)));
+
+  *digits = (unsigned int)_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha));
+  return _mm_or_si128(_mm_and_si128(isDigit, d), _mm_and_si128(isAlpha, a));
+}
+
+/* combine nibbles: high nibble at pair offset, low nibble follows */
+static inline __m128i textScan_combine(__m128i nib)
+{
+  /* nibbles are below 16, the 16 bit shift does not cross bytes */
+  return _mm_or_si128(_mm_slli_epi16(nib, 4), _mm_srli_si128(nib, 1));
+}
+
+static unsigned int textScan_hexPairsSse2(const char *p, const char *end,
+                                          uint8 *byte_arr, unsigned int max,
+                                          const char **next)
+{
+  unsigned int n = 0;
+
+  while((max - n >= 5) && (end - p >= 16)) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    unsigned int digits, blanks, bad, k;
+    uint8 tmp[16];
+
+    blanks = (unsigned int)_mm_movemask_epi8(
+               _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    v = textScan_combine(textScan_nibbles(v, &digits));
+    bad = (~digits & TEXTSCAN_DIGIT_MASK) | (~blanks & TEXTSCAN_BLANK_MASK);
+
+    _mm_storeu_si128((__m128i *)tmp, v);
+    k = textScan_validPairs(bad);
+    byte_arr[n]     = tmp[0];
+    byte_arr[n + 1] = tmp[3];
+    byte_arr[n + 2] = tmp[6];
+    byte_arr[n + 3] = tmp[9];
+    byte_arr[n + 4] = tmp[12];
+    n += k;
+    p += 3 * k;
+    if(k < 5) {
+      *next = p;
+      return n;
+    }
+  }
+
+  /* remaining pairs near the end of text or of the request */
+  return n + textScan_hexPairsScalar(p, end, byte_arr + n, max - n, next);
+}
+#endif
+
+#ifdef TEXTSCAN_AVX2
+/*
+ * two 16 byte lanes, loaded from p and p + 15, hold 10 pairs;
+ * the shuffle collects the pair offsets 0, 3, 6, 9 and 12 of each lane
+ */
+__attribute__((target("avx2")))
+static unsigned int textScan_hexPairsAvx2(const char *p, const char *end,
+                                          uint8 *byte_arr, unsigned int max,
+                                          const char **next)
+{
+  const __m256i collect = _mm256_setr_epi8(
+    0, 3, 6, 9, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    0, 3, 6, 9, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  unsigned int n = 0;
+
+  while((max - n >= 10) && (end - p >= 31)) {
+    __m256i v = _mm256_inserti128_si256(
+                  _mm256_castsi128_si256(
+                    _mm_loadu_si128((const __m128i *)p)),
+                  _mm_loadu_si128((const __m128i *)(p + 15)), 1);
+    const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    const __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    const __m256i a = _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10));
+    const __m256i isDigit = _mm256_and_si256(
+      _mm256_cmpgt_epi8(d, _mm256_set1_epi8(-1)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(10), d));
+    const __m256i isAlpha = _mm256_and_si256(
+      _mm256_cmpgt_epi8(a, _mm256_set1_epi8(9)),
+      _mm256_cmpgt_epi8(_mm256_set1_epi8(16), a));
+    uint32 digits, blanks, bad, k;
+    __m256i nib;
+    uint8 tmp[32];
+
+    digits = (uint32)_mm256_movemask_epi8(_mm256_or_si256(isDigit, isAlpha));
+    blanks = (uint32)_mm256_movemask_epi8(
+               _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    nib = _mm256_or_si256(_mm256_and_si256(isDigit, d),
+                          _mm256_and_si256(isAlpha, a));
+    v = _mm256_or_si256(_mm256_slli_epi16(nib, 4),
+                        _mm256_srli_si256(nib, 1));
+    v = _mm256_shuffle_epi8(v, collect);
+    _mm256_storeu_si256((__m256i *)tmp, v);
+
+    bad = (~digits & (TEXTSCAN_DIGIT_MASK | (TEXTSCAN_DIGIT_MASK << 16)))
+        | (~blanks & (TEXTSCAN_BLANK_MASK | (TEXTSCAN_BLANK_MASK << 16)));
+    memcpy(byte_arr + n, tmp, 5);
+    memcpy(byte_arr + n + 5, tmp + 16, 5);
+    k = textScan_validPairs(bad & 0x7FFFu);
+    if(k == 5) k += textScan_validPairs(bad >> 16);
+    n += k;
+    p += 3 * k;
+    if(k < 10) {
+      *next = p;
+      return n;
+    }
+  }
+
+  /* remaining pairs near the end of text or of the request */
+  return n + textScan_hexPairsSse2(p, end, byte_arr + n, max - n, next);
+}
+#endif
+
+unsigned int textScan_hexPairs(const char *p, const char *end,
+                               uint8 *byte_arr, unsigned int max,
+                               const char **next)
+{
+  switch(textScan_level()) {
+#ifdef TEXTSCAN_AVX2
+  case textScan_avx2:
+    return textScan_hexPairsAvx2(p, end, byte_arr, max, next);
+#endif
+#ifdef TEXTSCAN_SSE2
+  case textScan_sse2:
+    return textScan_hexPairsSse2(p, end, byte_arr, max, next);
+#endif
+  default:
+    return textScan_hexPairsScalar(p, end, byte_arr, max, next);
+  }
+}
+
+/*
+ * time stamps
+ */
+int textScan_timeScalar(const char *p, const char *end,
+                        uint64_t *sec, uint32 *nsec)
+{
+  const char *start = p;
+  uint64_t s = 0;
+  uint32 ns = 0;
+  int i;
+
+  while((p < end) && (*p >= '0') && (*p <= '9')) {
+    s = s * 10 + (uint64_t)(*p++ - '0');
+  }
+  if((p == start) || (p == end) || (*p != '.')) return -1;
+  p++;
+
+  for(i = 0; i < 9; i++) {
+    ns *= 10;
+    if((p < end) && (*p >= '0') && (*p <= '9')) ns += (uint32)(*p++ - '0');
+  }
+  *sec  = s;
+  *nsec = ns;
+  return 0;
+}
+
+#ifndef WORDS_BIGENDIAN
+/*
+ * SWAR conversion of 8 characters in a 64 bit register, the first
+ * character in the least significant byte
+ */
+
+/* number of leading decimal digits */
+static inline unsigned int textScan_digits8(uint64_t v)
+{
+  /* offsets above 9 (or negative) set the high bit of their byte */
+  uint64_t x = v ^ 0x3030303030303030ULL;
+  uint64_t t = ((x + 0x7676767676767676ULL) | x) & 0x8080808080808080ULL;
+
+  return t ? (unsigned int)__builtin_ctzll(t) / 8 : 8;
+}
+
+/* value of the first n (1..8) digits */
+static inline uint32 textScan_value8(uint64_t v, unsigned int n)
+{
+  /* move digits to the top, leading bytes become zeros */
+  v = (v & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - n));
+  v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFULL;
+  v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFULL;
+  v = (v * 10000 + (v >> 32)) & 0x00000000FFFFFFFFULL;
+  return (uint32)v;
+}
+
+static inline uint64_t textScan_load8(const char *p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/* powers of ten scaling a fraction of n digits to nanoseconds */
+static const uint32 textScan_nsecScale[10] = {
+  0, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1
+};
+
+static int textScan_timeSwar(const char *p, const char *end,
+                             uint64_t *sec, uint32 *nsec)
+{
+  uint64_t v;
+  unsigned int n, f;
+  uint32 frac;
+
+  /* integer part and fraction must be within reach */
+  if(end - p < 19) return textScan_timeScalar(p, end, sec, nsec);
+
+  v = textScan_load8(p);
+  n = textScan_digits8(v);
+  if((n == 0) || (n == 8) || (p[n] != '.')) {
+    return textScan_timeScalar(p, end, sec, nsec);
+  }
+  *sec = textScan_value8(v, n);
+
+  p += n + 1;
+  v = textScan_load8(p);
+  f = textScan_digits8(v);
+  if(f == 0) {
+    frac = 0;
+  } else if(f < 8) {
+    frac = textScan_value8(v, f) * textScan_nsecScale[f];
+  } else {
+    /* 9th decimal place */
+    frac = textScan_value8(v, 8) * 10;
+    if((p[8] >= '0') && (p[8] <= '9')) frac += (uint32)(p[8] - '0');
+  }
+  *nsec = frac;
+  return 0;
+}
+#endif
+
+int textScan_time(const char *p, const char *end,
+                  uint64_t *sec, uint32 *nsec)
+{
+#ifndef WORDS_BIGENDIAN
+  if(textScan_level() > textScan_scalar) {
+    return textScan_timeSwar(p, end, sec, nsec);
+  }
+#endif
+  return textScan_timeScalar(p, end, sec, nsec);
+}
@@ -0,0 +1,103 @@
+#ifndef INCLUDE_TEXTSCAN_H
+#define INCLUDE_TEXTSCAN_H
+
+/*  textscan.h -- declarations for text trace scanning kernels
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dbctypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Kernels for converting numbers of text trace files
+ *
+ * All kernels read at most up to end, the text needs no terminating
+ * NUL character. The vector implementations are selected at run time,
+ * each one gives the same result as the scalar implementation.
+ */
+
+/* instruction set levels, in ascending order */
+typedef enum {
+  textScan_scalar = 0,
+  textScan_sse2,
+  textScan_avx2
+} textScanLevel_t;
+
+/*
+ * limit the instruction set level, e.g. for testing
+ *
+ * returns the level in use, which is also limited by the CPU
+ */
+textScanLevel_t textScan_setLevel(textScanLevel_t level);
+
+/*
+ * instruction set level in use
+ *
+ * The level is resolved on the first call and kept until the next
+ * textScan_setLevel(); call it before starting threads that scan text.
+ */
+textScanLevel_t textScan_getLevel(void);
+
+/*
+ * decode a run of hex pairs separated by single blanks, "00 1a FF ..."
+ *
+ * Decoding stops at the first pair that is not followed by a blank and
+ * after max pairs.
+ *
+ * p        first character of the run
+ * end      end of text
+ * byte_arr decoded bytes
+ * max      maximum number of pairs to decode
+ * next     position after the blank of the last decoded pair
+ *
+ * returns the number of decoded pairs
+ */
+unsigned int textScan_hexPairs(const char *p, const char *end,
+                               uint8 *byte_arr, unsigned int max,
+                               const char **next);
+unsigned int textScan_hexPairsScalar(const char *p, const char *end,
+                                     uint8 *byte_arr, unsigned int max,
+                                     const char **next);
+
+/*
+ * decode a fixed-point decimal time stamp, "12.345678"
+ *
+ * The fractional part has 1-9 decimal places, further decimal places
+ * are ignored. Conversion stops at the first non-digit, like strtoul().
+ *
+ * p        first character of the time stamp
+ * end      end of text
+ * sec      integer part
+ * nsec     fractional part in nanoseconds
+ *
+ * returns 0 on success, -1 if there is no integer part followed by '.'
+ */
+int textScan_time(const char *p, const char *end,
+                  uint64_t *sec, uint32 *nsec);
+int textScan_timeScalar(const char *p, const char *end,
+                        uint64_t *sec, uint32 *nsec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,9 +18,19 @@
 
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_MMAP
+# include <fcntl.h>
+#endif
 
 #include "blfapi.h"
 #include "blfparser.h"
+#include "filemap.h"
+
+/* number of threads for reading, 0 selects the number of online CPUs */
+static unsigned int blfThreads = 0;
 
 /* read object header base of next object */
 success_t
@@ -35,15 +45,82 @@ fail:
   return 0;
 }
 
-/* open a BLF file for reading */
+/*
+ * set number of threads for reading BLF files: containers of large
+ * files are read ahead and inflated on nThreads - 1 worker threads
+ *
+ * n        number of threads, 0 selects the number of online CPUs
+ */
+void
+blfSetThreads(unsigned int n)
+{
+  blfThreads = n;
+}
+
+/* number of reader threads */
+static unsigned int
+blfThreadCount(void)
+{
+  long nThreads = blfThreads;
+
+#ifdef _SC_NPROCESSORS_ONLN
+  if(nThreads == 0) nThreads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(nThreads < 1) nThreads = 1;
+  return (unsigned int)nThreads;
+}
+
+#ifdef HAVE_MMAP
+/* open a mapped BLF file, the mapping is released on failure */
+static BLFHANDLE
+blfCreateMapping(void *map, size_t size)
+{
+  BLFHANDLE h = (BLFHANDLE)malloc(sizeof(*h));
+
+  if(h == NULL) {
+    munmap(map, size);
+    return NULL;
+  }
+  blfHandleInit(h);
+  if(!blfHandleOpenMapped(h, map, size, blfThreadCount())) {
+    free(h);
+    return NULL;
+  }
+  return h;
+}
+#endif
+
+/*
+ * open a BLF file for reading
+ *
+ * Regular files are read from a memory mapping and fp is closed,
+ * other files like pipes are read through fp.
+ */
 BLFHANDLE
 blfCreateFile(FILE *fp)
 {
-  BLFHANDLE h = (BLFHANDLE)malloc(sizeof(*h));
+  BLFHANDLE h;
+
+#ifdef HAVE_MMAP
+  {
+    void *map;
+    size_t size;
 
+    if(   (fp != NULL)
+       && (ftell(fp) == 0)
+       && ((map = fileMap_open(fileno(fp), &size)) != NULL)) {
+      h = blfCreateMapping(map, size);
+      if(h == NULL) goto fail;
+      fclose(fp);
+      return h;
+    }
+  }
+#endif
+
+  h = (BLFHANDLE)malloc(sizeof(*h));
   if(h == NULL) goto fail;
   blfHandleInit(h);
-  if(!blfHandleOpen(h, fp)) goto fail;
+  if(!blfHandleOpen(h, fp, blfThreadCount())) goto fail;
   return h;
 
 fail:
@@ -52,12 +129,42 @@ fail:
   return NULL;
 }
 
-/* close BLFHANDLE */
+/* open a BLF file for reading from a memory mapping */
+BLFHANDLE
+blfCreateFileMapped(const char *path)
+{
+#ifdef HAVE_MMAP
+  void *map;
+  size_t size;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if(fd == -1) goto fail;
+  map = fileMap_open(fd, &size);
+  close(fd);
+  if(map != NULL) {
+    BLFHANDLE h = blfCreateMapping(map, size);
+
+    if(h != NULL) return h;
+  }
+
+fail:
+#endif
+  fprintf(stderr,"blfCreateFileMapped() failed\n");
+  return NULL;
+}
+
+/* close BLFHANDLE and free it */
 success_t
 blfCloseHandle(BLFHANDLE h)
 {
-  return    blfHandleIsInitialized(h)
-         && blfHandleClose(h);
+  success_t success;
+
+  if(!blfHandleIsInitialized(h)) return 0;
+  success = blfHandleClose(h);
+  h->magic = 0;
+  free(h);
+  return success;
 }
 
 /* retrieve VBLFileStatisticsEx data */
@@ -89,9 +196,13 @@ blfReadObject(BLFHANDLE hFile, VBLObjectHeaderBase *pBase)
     case BL_OBJ_TYPE_CAN_ERROR_EXT:
     case BL_OBJ_TYPE_CAN_MESSAGE:
     case BL_OBJ_TYPE_CAN_MESSAGE2:
+    case BL_OBJ_TYPE_CAN_FD_MESSAGE:
+    case BL_OBJ_TYPE_CAN_FD_MESSAGE_64:
     case BL_OBJ_TYPE_LOG_CONTAINER:
+      /* objects are padded to 4 bytes, like in blfHandleSkip() */
       success = blfHandleRead(hFile, 0, (uint8_t *)&pBase[1],
-          pBase->mObjectSize - sizeof(*pBase));
+          pBase->mObjectSize - sizeof(*pBase))
+        && blfHandleSkipPadding(hFile, pBase->mObjectSize);
       break;
     default:
       fprintf(stderr, "blfReadObject: mObjectType not "
@@ -171,3 +282,23 @@ blfSkipObject(BLFHANDLE h, VBLObjectHeaderBase* pBase)
   }
   return success;
 }
+
+/*
+ * pointer to next object, if it lies within the current uncompressed
+ * container and has at least expectedSize bytes. pBase must be the
+ * header base returned by blfPeekObject(). The pointer is valid until
+ * the object is skipped with blfSkipObject().
+ */
+const VBLObjectHeaderBase *
+blfGetObjectPointer(BLFHANDLE h, const VBLObjectHeaderBase* pBase,
+                    size_t expectedSize)
+{
+  if(!blfHandleIsInitialized(h))          return NULL;
+  if(pBase == NULL)                       return NULL;
+  if(pBase->mObjectSize < expectedSize)   return NULL;
+  if(pBase->mObjectSize < sizeof(*pBase)) return NULL;
+
+  return (const VBLObjectHeaderBase *)
+    blfSizedStreamPeek(&h->mDualStream.memStream, sizeof(*pBase),
+                       pBase->mObjectSize - sizeof(*pBase));
+}
@@ -38,10 +38,22 @@ extern "C" {
 #define BL_OBJ_TYPE_CAN_DRIVER_ERROR      31
 #define BL_OBJ_TYPE_CAN_ERROR_EXT         73
 #define BL_OBJ_TYPE_CAN_MESSAGE2          86
+#define BL_OBJ_TYPE_CAN_FD_MESSAGE       100
+#define BL_OBJ_TYPE_CAN_FD_MESSAGE_64    101
 
 #define BL_OBJ_FLAG_TIME_TEN_MICS 1
 #define BL_OBJ_FLAG_TIME_ONE_NANS       2
 
+/* VBLCANFDMessage.mCANFDFlags */
+#define BL_CANFD_FLAG_EDL  0x01      /* extended data length: CAN FD */
+#define BL_CANFD_FLAG_BRS  0x02      /* bit rate switch */
+#define BL_CANFD_FLAG_ESI  0x04      /* error state indicator */
+
+/* VBLCANFDMessage64.mFlags */
+#define BL_CANFD64_FLAG_EDL 0x1000   /* extended data length: CAN FD */
+#define BL_CANFD64_FLAG_BRS 0x2000   /* bit rate switch */
+#define BL_CANFD64_FLAG_ESI 0x4000   /* error state indicator */
+
 typedef struct __attribute__ ((__packed__)) {
   uint16_t wYear;
   uint16_t wMonth;
@@ -107,6 +119,54 @@ typedef struct __attribute__ ((__packed__)) {
   uint8_t         mData[8];    /* 40 */
 } VBLCANMessage;
 
+typedef struct __attribute__ ((__packed__)) {
+  VBLObjectHeader mHeader;     /*  0: header */
+  uint16_t        mChannel;    /* 32: channel*/
+  uint8_t         mFlags;      /* 34: flags */
+  uint8_t         mDLC;        /* 35: DLC */
+  uint32_t        mID;         /* 36: message ID*/
+  uint8_t         mData[8];    /* 40 */
+  uint32_t        mFrameLength;/* 48: frame length in ns */
+  uint8_t         mBitCount;   /* 52: bit count */
+  uint8_t         mReserved1;  /* 53 */
+  uint16_t        mReserved2;  /* 54 */
+} VBLCANMessage2;
+
+typedef struct __attribute__ ((__packed__)) {
+  VBLObjectHeader mHeader;        /*  0: header */
+  uint16_t        mChannel;       /* 32: channel*/
+  uint8_t         mFlags;         /* 34: flags */
+  uint8_t         mDLC;           /* 35: DLC */
+  uint32_t        mID;            /* 36: message ID*/
+  uint32_t        mFrameLength;   /* 40: frame length in ns */
+  uint8_t         mArbBitCount;   /* 44: bit count of arbitration phase */
+  uint8_t         mCANFDFlags;    /* 45: BL_CANFD_FLAG_* */
+  uint8_t         mValidDataBytes;/* 46: valid payload length */
+  uint8_t         mReserved1;     /* 47 */
+  uint32_t        mReserved2;     /* 48 */
+  uint8_t         mData[64];      /* 52 */
+} VBLCANFDMessage;
+
+typedef struct __attribute__ ((__packed__)) {
+  VBLObjectHeader mHeader;        /*  0: header */
+  uint8_t         mChannel;       /* 32: channel*/
+  uint8_t         mDLC;           /* 33: DLC */
+  uint8_t         mValidDataBytes;/* 34: valid payload length */
+  uint8_t         mTxCount;       /* 35: TX request count */
+  uint32_t        mID;            /* 36: message ID*/
+  uint32_t        mFrameLength;   /* 40: frame length in ns */
+  uint32_t        mFlags;         /* 44: BL_CANFD64_FLAG_* */
+  uint32_t        mBtrCfgArb;     /* 48: bit timing, arbitration phase */
+  uint32_t        mBtrCfgData;    /* 52: bit timing, data phase */
+  uint32_t        mTimeOffsetBrsNs;   /* 56 */
+  uint32_t        mTimeOffsetCrcDelNs;/* 60 */
+  uint16_t        mBitCount;      /* 64: bit count */
+  uint8_t         mDir;           /* 66: direction */
+  uint8_t         mExtDataOffset; /* 67: offset of extended data */
+  uint32_t        mCRC;           /* 68: CRC */
+  uint8_t         mData[64];      /* 72: mValidDataBytes bytes */
+} VBLCANFDMessage64;
+
 typedef struct VBLFileStatistics_t {
   uint32_t  mStatisticsSize;                   /* sizeof (VBLFileStatistics) */
   uint8_t   mApplicationID;                    /* application ID */
@@ -134,10 +194,17 @@ typedef struct VBLFileStatisticsEx_t {
   uint32_t      mReserved[18];                 /* reserved */
 } VBLFileStatisticsEx;
 
+struct blfPipeline_s;
+typedef struct blfInflater_s blfInflater_t;
+
 typedef struct {
   uint32_t            magic;
   LOGG_t              mLOGG;
   DualStream          mDualStream;
+  struct blfPipeline_s *mPipeline; /* read-ahead, NULL if inactive */
+  blfBufferPool_t    *mPool;     /* container buffers */
+  blfInflater_t      *mInflater; /* inflate state */
+  unsigned int        mThreads;  /* reader threads */
   uint32_t            mPeekFlag;
   VBLFileStatisticsEx mStatistics;
   uint32_t            mCANMessageFormat_v1;
@@ -146,6 +213,8 @@ typedef struct {
 /* public functions */
 success_t blfPeekObject(BLFHANDLE h, VBLObjectHeaderBase* pBase);
 BLFHANDLE  blfCreateFile(FILE *fp);
+BLFHANDLE  blfCreateFileMapped(const char *path);
+void      blfSetThreads(unsigned int n);
 success_t blfCloseHandle(BLFHANDLE h);
 success_t blfGetFileStatisticsEx(BLFHANDLE h, VBLFileStatisticsEx* pStatistics);
 success_t blfReadObject(BLFHANDLE hFile, VBLObjectHeaderBase *pBase);
@@ -153,6 +222,9 @@ success_t blfFreeObject(BLFHANDLE h, VBLObjectHeaderBase* pBase);
 success_t blfSkipObject(BLFHANDLE h, VBLObjectHeaderBase* pBase);
 success_t blfReadObjectSecure(BLFHANDLE h, VBLObjectHeaderBase* pBase,
                               size_t expectedSize);
+const VBLObjectHeaderBase *blfGetObjectPointer(BLFHANDLE h,
+                                      const VBLObjectHeaderBase* pBase,
+                                      size_t expectedSize);
 
 #ifdef __cplusplus
 }
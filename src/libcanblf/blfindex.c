@@ -0,0 +1,474 @@
+/*  blfindex.c -- container index of BLF files
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "blfindex.h"
+#include "blfparser.h"
+
+/* sidecar file header */
+#define BLF_INDEX_MAGIC   0x49464C42       /* 'BLFI' */
+#define BLF_INDEX_VERSION 1
+
+/* maximum payload size of an entry for objects outside of containers */
+#define BLF_INDEX_RUN_SIZE (64u * 1024u)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fileSize;
+  int64_t  fileTime;
+  uint32_t nEntries;
+  uint32_t reserved;
+} blfIndexFileHeader_t;
+
+/* object boundaries across container payloads */
+typedef struct {
+  uint8_t  header[sizeof(VBLObjectHeader)]; /* header read so far */
+  uint32_t nHeader;  /* bytes of header read so far */
+  uint32_t owner;    /* entry of the container the object starts in */
+  uint64_t skip;     /* bytes up to the next object */
+} blfIndexScanner_t;
+
+/* time stamp of object in nanoseconds */
+static uint64_t
+blfIndexTime(const VBLObjectHeader *header)
+{
+  if(header->mObjectFlags & BL_OBJ_FLAG_TIME_TEN_MICS) {
+    return header->mObjectTimeStamp * 10000u;
+  } else if(header->mObjectFlags & BL_OBJ_FLAG_TIME_ONE_NANS) {
+    return header->mObjectTimeStamp;
+  }
+  return 0;
+}
+
+/* modification time and size of file */
+static success_t
+blfIndexFileStat(const char *path, uint64_t *sizePtr, int64_t *timePtr)
+{
+  struct stat st;
+
+  if(stat(path, &st) != 0) return 0;
+  if(!S_ISREG(st.st_mode)) return 0;
+  *sizePtr = (uint64_t)st.st_size;
+  *timePtr = (int64_t)st.st_mtime;
+  return 1;
+}
+
+/* name of sidecar file, to be freed by the caller */
+static char *
+blfIndexSidecarName(const char *path)
+{
+  char *name = (char *)malloc(strlen(path) + sizeof(BLF_INDEX_SUFFIX));
+
+  if(name != NULL) {
+    strcpy(name, path);
+    strcat(name, BLF_INDEX_SUFFIX);
+  }
+  return name;
+}
+
+/* append entry for container at offset */
+static blfIndexEntry_t *
+blfIndexAppend(blfIndex_t *index, uint32_t *capacity, uint64_t offset,
+               uint32_t uncompressedSize)
+{
+  blfIndexEntry_t *e;
+
+  if(index->nEntries == *capacity) {
+    uint32_t newCapacity = *capacity ? 2 * *capacity : 1024;
+    blfIndexEntry_t *entry = (blfIndexEntry_t *)
+      realloc(index->entry, newCapacity * sizeof(*entry));
+
+    if(entry == NULL) return NULL;
+    index->entry = entry;
+    *capacity = newCapacity;
+  }
+  e = &index->entry[index->nEntries++];
+  e->offset = offset;
+  e->uncompressedSize = uncompressedSize;
+  e->firstObject = uncompressedSize;
+  e->minTime = UINT64_MAX;
+  e->maxTime = 0;
+  return e;
+}
+
+/*
+ * find object boundaries and time stamps in payload of last entry
+ *
+ * returns 0 if an object header is invalid
+ */
+static success_t
+blfIndexScan(blfIndexScanner_t *s, blfIndex_t *index,
+             const uint8_t *data, uint32_t size)
+{
+  const uint32_t current = index->nEntries - 1;
+  blfIndexEntry_t *e = &index->entry[current];
+  const VBLObjectHeader *header = (const VBLObjectHeader *)s->header;
+  uint32_t pos = 0;
+
+  while(pos < size) {
+    uint32_t need = sizeof(header->mBase);
+    uint32_t n;
+    int timed;
+
+    if(s->skip > 0) {
+      /* remainder of previous object */
+      n = (uint32_t)BLFMIN(s->skip, (uint64_t)(size - pos));
+      pos += n;
+      s->skip -= n;
+      continue;
+    }
+    if(s->nHeader == 0) {
+      /* object starts in this container */
+      if(e->firstObject == e->uncompressedSize) e->firstObject = pos;
+      s->owner = current;
+    }
+
+    /* object header, may be split between two containers */
+    timed =    (s->nHeader >= sizeof(header->mBase))
+            && (header->mBase.mHeaderSize >= sizeof(*header))
+            && (header->mBase.mObjectSize >= sizeof(*header));
+    if(timed) need = sizeof(*header);
+    n = BLFMIN(need - s->nHeader, size - pos);
+    memcpy(s->header + s->nHeader, data + pos, n);
+    s->nHeader += n;
+    pos += n;
+    if(s->nHeader < need) continue;
+
+    if(header->mBase.mSignature != BL_OBJ_SIGNATURE)       return 0;
+    if(header->mBase.mObjectSize < sizeof(header->mBase))  return 0;
+    if(!timed && (header->mBase.mHeaderSize >= sizeof(*header))
+              && (header->mBase.mObjectSize >= sizeof(*header))) {
+      /* read time stamp */
+      continue;
+    }
+    if(timed) {
+      blfIndexEntry_t *owner = &index->entry[s->owner];
+      const uint64_t t = blfIndexTime(header);
+
+      if(t < owner->minTime) owner->minTime = t;
+      if(t > owner->maxTime) owner->maxTime = t;
+    }
+    s->skip =   header->mBase.mObjectSize - s->nHeader
+              + (header->mBase.mObjectSize & 3);
+    s->nHeader = 0;
+  }
+  return 1;
+}
+
+/* read n bytes into buffer of size *capacity, growing it as needed */
+static success_t
+blfIndexRead(FILE *fp, uint8_t **bufPtr, uint32_t *capacity, uint32_t n)
+{
+  if(n > *capacity) {
+    uint8_t *buffer = (uint8_t *)realloc(*bufPtr, n);
+
+    if(buffer == NULL) return 0;
+    *bufPtr = buffer;
+    *capacity = n;
+  }
+  return (n == 0) || (1 == fread(*bufPtr, n, 1, fp));
+}
+
+/*
+ * build index of LOG containers in one pass over a BLF file, objects
+ * outside of containers are indexed in runs
+ *
+ * returns NULL on error
+ */
+blfIndex_t *
+blfBuildIndex(const char *path)
+{
+  blfIndex_t *index = NULL;
+  blfIndexScanner_t scanner;
+  blfInflater_t *inf = NULL;
+  uint8_t *input = NULL, *output = NULL;
+  uint32_t inputCapacity = 0, outputCapacity = 0, capacity = 0;
+  uint32_t logg[2];
+  int inRun = 0;
+  FILE *fp;
+
+  fp = fopen(path, "rb");
+  if(fp == NULL) goto fail;
+
+  index = (blfIndex_t *)calloc(1, sizeof(*index));
+  inf = blfInflaterCreate();
+  if((index == NULL) || (inf == NULL))                       goto fail;
+  if(!blfIndexFileStat(path, &index->fileSize, &index->fileTime)) goto fail;
+  memset(&scanner, 0, sizeof(scanner));
+
+  /* skip LOGG header */
+  if(1 != fread(logg, sizeof(logg), 1, fp))                  goto fail;
+  if(logg[0] != BL_LOGG_SIGNATURE)                           goto fail;
+  if(0 != fseek(fp, logg[1], SEEK_SET))                      goto fail;
+
+  while(1) {
+    VBLObjectHeaderBaseLOGG header;
+#ifdef HAVE_FSEEKO
+    const off_t offset = ftello(fp);  /* files beyond 2 GByte */
+#else
+    const long offset = ftell(fp);
+#endif
+    uint32_t padding;
+
+    if(offset < 0)                                           goto fail;
+    if(1 != fread(&header.base, sizeof(header.base), 1, fp)) break;
+    if(header.base.mSignature != BL_OBJ_SIGNATURE)           goto fail;
+    if(header.base.mObjectSize < sizeof(header.base))        goto fail;
+    padding = header.base.mObjectSize & 3;
+
+    if(   (header.base.mObjectType == BL_OBJ_TYPE_LOG_CONTAINER)
+       && (header.base.mObjectSize >= sizeof(header))) {
+      const uint32_t nInput = header.base.mObjectSize - sizeof(header);
+      uint8_t *payload;
+      uint32_t nPayload = nInput;
+
+      if(1 != fread(&header.compressedflag,
+                    sizeof(header) - sizeof(header.base), 1, fp)) goto fail;
+      if(!blfIndexRead(fp, &input, &inputCapacity, nInput))  goto fail;
+      payload = input;
+      if(header.compressedflag == 2) {
+        nPayload = header.deflatebuffersize;
+        if(nPayload > outputCapacity) {
+          uint8_t *buffer = (uint8_t *)realloc(output, nPayload);
+
+          if(buffer == NULL)                                 goto fail;
+          output = buffer;
+          outputCapacity = nPayload;
+        }
+        if(!blfInflaterRun(inf, output, nPayload,
+                           input, nInput, NULL))             goto fail;
+        payload = output;
+      }
+      if(!blfIndexAppend(index, &capacity, (uint64_t)offset,
+                         nPayload))                          goto fail;
+      if(!blfIndexScan(&scanner, index, payload, nPayload))  goto fail;
+      if(padding && (0 != fseek(fp, padding, SEEK_CUR)))     goto fail;
+      inRun = 0;
+    } else {
+      /* other top-level objects are indexed in runs */
+      const uint32_t nObject = header.base.mObjectSize + padding;
+      blfIndexEntry_t *e;
+
+      if(!blfIndexRead(fp, &input, &inputCapacity,
+                       nObject - sizeof(header.base)))        goto fail;
+      e = (inRun && (index->nEntries > 0))
+        ? &index->entry[index->nEntries - 1] : NULL;
+      if(   (e == NULL)
+         || (e->uncompressedSize + nObject > BLF_INDEX_RUN_SIZE)) {
+        e = blfIndexAppend(index, &capacity, (uint64_t)offset, 0);
+        if(e == NULL)                                        goto fail;
+        e->firstObject = 0;
+      }
+      e->uncompressedSize += nObject;
+      if(   (header.base.mHeaderSize >= sizeof(VBLObjectHeader))
+         && (header.base.mObjectSize >= sizeof(VBLObjectHeader))) {
+        VBLObjectHeader object;
+        uint64_t t;
+
+        object.mBase = header.base;
+        memcpy(&object.mObjectFlags, input,
+               sizeof(object) - sizeof(object.mBase));
+        t = blfIndexTime(&object);
+        if(t < e->minTime) e->minTime = t;
+        if(t > e->maxTime) e->maxTime = t;
+      }
+      inRun = 1;
+    }
+  }
+
+  blfInflaterFree(inf);
+  free(input);
+  free(output);
+  fclose(fp);
+  return index;
+
+fail:
+  fprintf(stderr, "blfBuildIndex(): can't index %s\n", path);
+  blfIndexFree(index);
+  blfInflaterFree(inf);
+  free(input);
+  free(output);
+  if(fp != NULL) fclose(fp);
+  return NULL;
+}
+
+/*
+ * load index from sidecar file of BLF file
+ *
+ * returns NULL if there is no sidecar file or if it is outdated
+ */
+blfIndex_t *
+blfIndexLoad(const char *path)
+{
+  blfIndexFileHeader_t fileHeader;
+  blfIndex_t *index = NULL;
+  uint64_t fileSize;
+  int64_t fileTime;
+  char *name;
+  FILE *fp = NULL;
+
+  if(!blfIndexFileStat(path, &fileSize, &fileTime))        goto fail;
+  name = blfIndexSidecarName(path);
+  if(name == NULL)                                         goto fail;
+  fp = fopen(name, "rb");
+  free(name);
+  if(fp == NULL)                                           goto fail;
+
+  if(1 != fread(&fileHeader, sizeof(fileHeader), 1, fp))   goto fail;
+  if(   (fileHeader.magic != BLF_INDEX_MAGIC)
+     || (fileHeader.version != BLF_INDEX_VERSION)
+     || (fileHeader.fileSize != fileSize)
+     || (fileHeader.fileTime != fileTime))                 goto fail;
+
+  index = (blfIndex_t *)calloc(1, sizeof(*index));
+  if(index == NULL)                                        goto fail;
+  index->fileSize = fileSize;
+  index->fileTime = fileTime;
+  index->nEntries = fileHeader.nEntries;
+  index->entry = (blfIndexEntry_t *)
+    malloc((fileHeader.nEntries + 1) * sizeof(*index->entry));
+  if(index->entry == NULL)                                 goto fail;
+  if(   (fileHeader.nEntries > 0)
+     && (1 != fread(index->entry,
+                    fileHeader.nEntries * sizeof(*index->entry),
+                    1, fp)))                                goto fail;
+  fclose(fp);
+  return index;
+
+fail:
+  blfIndexFree(index);
+  if(fp != NULL) fclose(fp);
+  return NULL;
+}
+
+/* save index as sidecar file of BLF file */
+success_t
+blfIndexSave(const blfIndex_t *index, const char *path)
+{
+  blfIndexFileHeader_t fileHeader;
+  char *name = blfIndexSidecarName(path);
+  FILE *fp;
+  success_t success;
+
+  if(name == NULL) return 0;
+  fp = fopen(name, "wb");
+  if(fp == NULL) {
+    free(name);
+    return 0;
+  }
+
+  memset(&fileHeader, 0, sizeof(fileHeader));
+  fileHeader.magic    = BLF_INDEX_MAGIC;
+  fileHeader.version  = BLF_INDEX_VERSION;
+  fileHeader.fileSize = index->fileSize;
+  fileHeader.fileTime = index->fileTime;
+  fileHeader.nEntries = index->nEntries;
+  success =    (1 == fwrite(&fileHeader, sizeof(fileHeader), 1, fp))
+            && (   (index->nEntries == 0)
+                || (1 == fwrite(index->entry,
+                                index->nEntries * sizeof(*index->entry),
+                                1, fp)));
+  success = (0 == fclose(fp)) && success;
+
+  /* don't leave a truncated index behind */
+  if(!success) remove(name);
+  free(name);
+  return success;
+}
+
+/*
+ * build index of BLF file
+ *
+ * With cache set, the index is loaded from the sidecar file and the
+ * sidecar is created or updated if required.
+ */
+blfIndex_t *
+blfIndexOpen(const char *path, int cache)
+{
+  blfIndex_t *index = cache ? blfIndexLoad(path) : NULL;
+
+  if(index == NULL) {
+    index = blfBuildIndex(path);
+
+    /* the index is still usable if it can't be saved */
+    if(cache && (index != NULL)) blfIndexSave(index, path);
+  }
+  return index;
+}
+
+void
+blfIndexFree(blfIndex_t *index)
+{
+  if(index == NULL) return;
+  free(index->entry);
+  free(index);
+}
+
+/* container has an object start */
+static int
+blfIndexEntryHasObjects(const blfIndexEntry_t *e)
+{
+  return e->firstObject < e->uncompressedSize;
+}
+
+/*
+ * position BLF handle on the containers with objects between startTime
+ * and endTime, given in nanoseconds
+ *
+ * Objects outside the time range are still read from the first and
+ * last containers and must be filtered by the caller.
+ */
+success_t
+blfIndexSeek(BLFHANDLE h, const blfIndex_t *index,
+             uint64_t startTime, uint64_t endTime)
+{
+  const blfIndexEntry_t *const entry = index->entry;
+  const uint32_t n = index->nEntries;
+  uint32_t first, last, i;
+  uint64_t end;
+
+  /* all containers before first end before startTime */
+  for(first = 0; first < n; first++) {
+    if(   blfIndexEntryHasObjects(&entry[first])
+       && (entry[first].maxTime >= startTime)) break;
+  }
+  if(first == n) {
+    return blfHandleSeek(h, index->fileSize, 0, index->fileSize);
+  }
+
+  /* all containers after last begin after endTime */
+  last = first;
+  for(i = first + 1; i < n; i++) {
+    if(   blfIndexEntryHasObjects(&entry[i])
+       && (entry[i].minTime <= endTime)) last = i;
+  }
+
+  /* the last object may end in one of the following containers */
+  for(i = last + 1; (i < n) && !blfIndexEntryHasObjects(&entry[i]); i++);
+  if(i < n) i++;
+  end = (i < n) ? entry[i].offset : index->fileSize;
+
+  return blfHandleSeek(h, entry[first].offset, entry[first].firstObject,
+                       end);
+}
@@ -0,0 +1,75 @@
+#ifndef INCLUDE_BLFINDEX_H
+#define INCLUDE_BLFINDEX_H
+
+/*  blfindex.h -- declarations for blfindex
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+#include "blfapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* file name suffix of the index sidecar file */
+#define BLF_INDEX_SUFFIX ".idx"
+
+/*
+ * one LOG container of a BLF file, or a run of other top-level objects
+ *
+ * Objects may span two containers. firstObject is the payload offset
+ * of the first object starting in the container, it equals
+ * uncompressedSize if no object starts in the container. Time stamps
+ * are given in nanoseconds. Objects of different channels may be
+ * slightly out of order, so the minimum and maximum time stamp of the
+ * objects starting in the container are recorded.
+ */
+typedef struct {
+  uint64_t offset;           /* file offset of container */
+  uint32_t uncompressedSize; /* payload size */
+  uint32_t firstObject;      /* payload offset of first object */
+  uint64_t minTime;          /* UINT64_MAX if no object starts here */
+  uint64_t maxTime;          /* 0 if no object starts here */
+} blfIndexEntry_t;
+
+typedef struct {
+  uint64_t         fileSize;     /* size of indexed file */
+  int64_t          fileTime;     /* modification time of indexed file */
+  uint32_t         nEntries;
+  blfIndexEntry_t *entry;
+} blfIndex_t;
+
+blfIndex_t *blfBuildIndex(const char *path);
+blfIndex_t *blfIndexLoad(const char *path);
+success_t   blfIndexSave(const blfIndex_t *index, const char *path);
+blfIndex_t *blfIndexOpen(const char *path, int cache);
+void        blfIndexFree(blfIndex_t *index);
+success_t   blfIndexSeek(BLFHANDLE h, const blfIndex_t *index,
+                         uint64_t startTime, uint64_t endTime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,7 @@
 
 #include "blfparser.h"
 #include "blfapi.h"
+#include "blfpipeline.h"
 
 /* clear memory */
 void
@@ -34,38 +35,88 @@ blfMemZero(uint8_t *mem, const size_t n)
   memset((char *)mem, 0, n);
 }
 
-/* in-memory zlib uncompress */
-static success_t
-blfMemUncompress(uint8_t  *next_out,
-     uint32_t  avail_out,
-     uint8_t  *next_in,
-     uint32_t  avail_in,
-     uint32_t *total_out_ptr)
+/* inflate state, reused for all containers of a handle */
+struct blfInflater_s {
+  z_stream stream;
+};
+
+/* create inflate state, NULL if out of memory */
+blfInflater_t *
+blfInflaterCreate(void)
+{
+  blfInflater_t *inf = (blfInflater_t *)malloc(sizeof(*inf));
+
+  if(inf == NULL) goto fail;
+  inf->stream.next_in = NULL;
+  inf->stream.avail_in = 0;
+  inf->stream.zalloc = NULL;
+  inf->stream.zfree = NULL;
+  inf->stream.opaque = NULL;
+  if(Z_OK != inflateInit_(&inf->stream, ZLIB_VERSION,
+                          sizeof(inf->stream))) goto fail_free;
+  return inf;
+
+fail_free:
+  free(inf);
+fail:
+  return NULL;
+}
+
+/* in-memory zlib uncompress with reused inflate state */
+success_t
+blfInflaterRun(blfInflater_t *inf,
+               uint8_t  *next_out,
+               uint32_t  avail_out,
+               uint8_t  *next_in,
+               uint32_t  avail_in,
+               uint32_t *total_out_ptr)
 {
+  z_stream *const stream = &inf->stream;
   int zres;
-  z_stream stream;
 
-  stream.next_in = next_in;
-  stream.avail_in = avail_in;
-  stream.next_out = next_out;
-  stream.avail_out = avail_out;
-  stream.total_out = 0;
-  stream.state = NULL;
-  stream.zalloc = NULL;
-  stream.zfree = NULL;
-
-  zres = inflateInit_(&stream, ZLIB_VERSION, sizeof(stream));
-  if(zres == Z_OK) zres = inflate(&stream, Z_FINISH);
+  zres = inflateReset(stream);
+  stream->next_in = next_in;
+  stream->avail_in = avail_in;
+  stream->next_out = next_out;
+  stream->avail_out = avail_out;
+
+  if(zres == Z_OK) zres = inflate(stream, Z_FINISH);
   if(zres == Z_STREAM_END) zres = Z_OK;
   if(zres == Z_OK) {
-    inflateEnd(&stream);
     if(total_out_ptr != NULL) {
-      *total_out_ptr = stream.total_out;
+      *total_out_ptr = stream->total_out;
     }
   }
   return zres == Z_OK;
 }
 
+/* free inflate state */
+void
+blfInflaterFree(blfInflater_t *inf)
+{
+  if(inf == NULL) return;
+  inflateEnd(&inf->stream);
+  free(inf);
+}
+
+/* in-memory zlib uncompress */
+success_t
+blfMemUncompress(uint8_t  *next_out,
+     uint32_t  avail_out,
+     uint8_t  *next_in,
+     uint32_t  avail_in,
+     uint32_t *total_out_ptr)
+{
+  blfInflater_t *inf = blfInflaterCreate();
+  success_t success;
+
+  if(inf == NULL) return 0;
+  success = blfInflaterRun(inf, next_out, avail_out,
+                           next_in, avail_in, total_out_ptr);
+  blfInflaterFree(inf);
+  return success;
+}
+
 /* initialize SYSTEMTIME structure */
 static void
 blfSystemTimeInit(SYSTEMTIME *const s)
@@ -119,6 +170,48 @@ blfStatisticsInit(VBLFileStatisticsEx *const s)
             sizeof(s->mReserved));
 }
 
+/*
+ * read bytes from the payloads handed out by the read-ahead pipeline,
+ * or skip bytes, if dest pointer is NULL
+ */
+static success_t
+blfHandleReadOrSkipPipelined(BLFHANDLE h, uint8_t *dest,
+                             uint32_t totalBytesToRead)
+{
+  DualStream *const ds = &h->mDualStream;
+
+  while(totalBytesToRead > 0) {
+    uint32_t n;
+
+    /* next container payload or top-level object */
+    if(blfSizedStreamIsEmpty(&ds->memStream)) {
+      const uint8_t *data;
+      uint8_t *buffer;
+      uint32_t size;
+
+      if(!blfPipelineNext(h->mPipeline, &data, &size, &buffer)) goto fail;
+      if(size == 0) {
+        blfBufferPoolPut(h->mPool, buffer);
+      } else if(buffer != NULL) {
+        blfSizedStreamInitFromMem(&ds->memStream, buffer, size);
+      } else {
+        blfSizedStreamInitFromView(&ds->memStream, data, size);
+      }
+      continue;
+    }
+
+    n = BLFMIN(totalBytesToRead, blfDualStreamBytesLeft(ds));
+    if(!blfDualStreamReadOrSkip(ds, dest, n, 0)) goto fail;
+    if(!blfDualStreamReduceBytesLeft(ds, n))     goto fail;
+    if(dest != NULL) dest += n;
+    totalBytesToRead -= n;
+  }
+  return 1;
+
+fail:
+  return 0;
+}
+
 /*
  * read bytes from either file or memory stream, or skip bytes, if
  * dest pointer is NULL
@@ -137,6 +230,10 @@ blfHandleReadOrSkip(BLFHANDLE h, uint8_t *dest,
   VBLObjectHeaderBase pBase;
   DualStream *const ds = &h->mDualStream;
 
+  if(h->mPipeline != NULL) {
+    return blfHandleReadOrSkipPipelined(h, dest, totalBytesToRead);
+  }
+
   /* loop until all bytes are read or dual stream is empty */
   while(alreadyRead < totalBytesToRead) {
     srcBytesLeft = blfDualStreamBytesLeft(ds);
@@ -193,7 +290,10 @@ blfHandleRead(BLFHANDLE h, uint8_t fileOnlyBit, uint8_t *dest_ptr,
   DualStream *const ds = &h->mDualStream;
   success_t success;
 
-  if(!(fileOnlyBit & 1) && blfSizedStreamIsOpen(&ds->fileStream)) {
+  /* the file is closed when drained, its last container may be left */
+  if(   !(fileOnlyBit & 1)
+     && (   blfSizedStreamIsOpen(&ds->fileStream)
+         || !blfSizedStreamIsEmpty(&ds->memStream))) {
     success = blfHandleReadOrSkip(h, dest_ptr, nBytes);
   } else {
     /* TODO: do we need an extra function for this? */
@@ -209,26 +309,31 @@ blfHandleSkipPadding(BLFHANDLE h, uint32_t nBytes)
   return ((nBytes & 3) == 0) || blfHandleRead(h, 0, NULL, nBytes & 3);
 }
 
-/* unpack compressed VBLObjectHeaderBaseLOGG payload if required  */
+/*
+ * unpack compressed VBLObjectHeaderBaseLOGG payload if required
+ *
+ * data and size describe the payload as stored in the file. For a
+ * compressed payload, bufPtr and sizePtr receive a pool buffer with
+ * the uncompressed data, otherwise they are left unchanged.
+ */
 success_t
-blfLOGGUncompress(VBLObjectHeaderBaseLOGG* hbaselogg,
+blfLOGGUncompress(BLFHANDLE h, VBLObjectHeaderBaseLOGG* hbaselogg,
+      const uint8_t *data, uint32_t size,
       uint8_t **bufPtr, uint32_t *sizePtr)
 {
   if(hbaselogg->compressedflag == 2) {
     uint8_t* uncompressedData;
     success_t suc;
 
-    uncompressedData = (uint8_t *)malloc(hbaselogg->deflatebuffersize);
+    uncompressedData = blfBufferPoolGet(h->mPool,
+                                        hbaselogg->deflatebuffersize);
     if(uncompressedData == NULL) {
       fprintf(stderr, "blfLOBJReadPayload: malloc failed\n");
       goto fail;
     }
-    suc = blfMemUncompress(uncompressedData,
-         hbaselogg->deflatebuffersize, *bufPtr,
-         *sizePtr, 0);
-
-    /* free compressed data */
-    free(*bufPtr);
+    suc = blfInflaterRun(h->mInflater, uncompressedData,
+         hbaselogg->deflatebuffersize, (uint8_t *)data,
+         size, 0);
 
     *sizePtr = hbaselogg->deflatebuffersize;
     *bufPtr = uncompressedData;
@@ -237,7 +342,7 @@ blfLOGGUncompress(VBLObjectHeaderBaseLOGG* hbaselogg,
       goto fail;
     }
   } else {
-    /* nothing to do. sizePtr and bufPtr point to the non-compressed data */
+    /* nothing to do. data points to the non-compressed data */
   }
   return 1;
 
@@ -251,6 +356,9 @@ blfHandleReadLOGG(VBLObjectHeaderBaseLOGG *hbaselogg, BLFHANDLE h)
 {
   uint32_t nObjectData;
   uint8_t *objectData = NULL;
+  uint8_t *uncompressedData = NULL;
+  uint32_t nUncompressedData = 0;
+  const uint8_t *mapped;
   DualStream *const ds = &h->mDualStream;
 
   /* nothing to do, if object is not a LOG container */
@@ -262,21 +370,39 @@ blfHandleReadLOGG(VBLObjectHeaderBaseLOGG *hbaselogg, BLFHANDLE h)
   /* complete reading of VBLHeaderBaseLOGG */
   if(!blfHandleRead(h, 0, (uint8_t *)&hbaselogg->compressedflag,
         sizeof(*hbaselogg) - hbaselogg->base.mHeaderSize))     goto fail;
-
-  /* allocate object data */
   nObjectData = hbaselogg->base.mObjectSize - sizeof(*hbaselogg);
-  if(NULL == (objectData = (uint8_t *)malloc(nObjectData)))    goto fail;
 
-  /* read object data */
-  if(!blfHandleRead(h, 0, objectData, nObjectData))            goto fail;
+  /* object data of a mapped file is used in place */
+  mapped = blfSizedStreamPeek(&ds->fileStream, 0, nObjectData);
+  if(mapped == NULL) {
+    /* allocate and read object data */
+    objectData = blfBufferPoolGet(h->mPool, nObjectData);
+    if(objectData == NULL)                                     goto fail;
+    if(!blfHandleRead(h, 0, objectData, nObjectData))          goto fail;
+  } else {
+    if(!blfHandleRead(h, 0, NULL, nObjectData))                goto fail;
+  }
   if(!blfHandleSkipPadding(h, nObjectData))                    goto fail;
 
   /* uncompress, if compressed */
-  if(!blfLOGGUncompress(hbaselogg, &objectData, &nObjectData)) goto fail;
+  if(!blfLOGGUncompress(h, hbaselogg,
+                        mapped ? mapped : objectData, nObjectData,
+                        &uncompressedData, &nUncompressedData)) goto fail;
 
   /* establish new memStream */
-  if(0 == blfSizedStreamInitFromMem(&ds->memStream,
-                                    objectData, nObjectData))  goto fail;
+  if(uncompressedData != NULL) {
+    /* recycle compressed data */
+    blfBufferPoolPut(h->mPool, objectData);
+    objectData = uncompressedData;
+    uncompressedData = NULL;
+    blfSizedStreamInitFromMem(&ds->memStream,
+                              objectData, nUncompressedData);
+  } else if(mapped != NULL) {
+    blfSizedStreamInitFromView(&ds->memStream, mapped, nObjectData);
+  } else {
+    blfSizedStreamInitFromMem(&ds->memStream, objectData, nObjectData);
+  }
+  objectData = NULL; /* owned by memStream */
 
   /* peek next object, if required */
   if(   (h->mPeekFlag == 0)
@@ -286,7 +412,8 @@ success:
   return 1;
 
 fail:
-  if(objectData != NULL) free(objectData);
+  blfBufferPoolPut(h->mPool, uncompressedData);
+  blfBufferPoolPut(h->mPool, objectData);
   return 0;
 }
 
@@ -382,6 +509,9 @@ blfCheckStructures(void)
   assert(sizeof(VBLObjectHeader) == 32);
   assert(sizeof(VBLObjectHeaderBaseLOGG) == 32);
   assert(sizeof(VBLCANMessage) == 48);
+  assert(sizeof(VBLCANMessage2) == 56);
+  assert(sizeof(VBLCANFDMessage) == 116);
+  assert(sizeof(VBLCANFDMessage64) == 136);
   assert(sizeof(VBLFileStatisticsEx) == 136);
 }
 
@@ -396,6 +526,10 @@ blfHandleInit(BLFHANDLE this)
 
   this->mCANMessageFormat_v1 = 0;
   blfDualStreamInit(&this->mDualStream);
+  this->mPipeline = NULL;
+  this->mPool = NULL;
+  this->mInflater = NULL;
+  this->mThreads = 1;
   this->mPeekFlag = 0;
   blfStatisticsInit(&(this->mStatistics));
 
@@ -413,7 +547,19 @@ blfHandleIsInitialized(BLFHANDLE h)
 success_t
 blfHandleClose(BLFHANDLE h)
 {
-  return blfDualStreamClose(&h->mDualStream);
+  /* stop read-ahead before the file is closed */
+  success_t success;
+
+  blfPipelineFree(h->mPipeline);
+  h->mPipeline = NULL;
+  success = blfDualStreamClose(&h->mDualStream);
+
+  /* buffers of the streams have been returned to the pool */
+  blfBufferPoolFree(h->mPool);
+  h->mPool = NULL;
+  blfInflaterFree(h->mInflater);
+  h->mInflater = NULL;
+  return success;
 }
 
 /* skip forward nBytes */
@@ -423,7 +569,7 @@ blfHandleSkip(BLFHANDLE h, uint32_t nBytes)
   success_t success;
   DualStream *const ds = &h->mDualStream;
 
-  if(!blfDualStreamIsEmpty(&h->mDualStream)) {
+  if((h->mPipeline != NULL) || !blfDualStreamIsEmpty(&h->mDualStream)) {
     success = blfHandleReadOrSkip(h, 0, nBytes);
   } else {
     success = blfDualStreamReadOrSkip(ds, NULL, nBytes, 1);
@@ -434,9 +580,12 @@ blfHandleSkip(BLFHANDLE h, uint32_t nBytes)
   return success;
 }
 
-/* associate BLFHANDLE with a FILE and read header and statistics */
-success_t
-blfHandleOpen(BLFHANDLE h, FILE *fp)
+/*
+ * read header and statistics from the file stream of BLFHANDLE,
+ * start read-ahead pipeline if nThreads > 1
+ */
+static success_t
+blfHandleOpenStream(BLFHANDLE h, unsigned int nThreads)
 {
   uint32_t nLOGGFile;
   uint32_t nRead;
@@ -446,8 +595,6 @@ blfHandleOpen(BLFHANDLE h, FILE *fp)
 
   h->mCANMessageFormat_v1 = 0;
 
-  if(!blfSizedStreamInitFromFile(&h->mDualStream.fileStream, fp)) goto fail;
-
   /* read signature and header size */
   if(!blfHandleRead(h, 1, (uint8_t *)&h->mLOGG.mSignature, nSignatureAndHeader)) {
     goto fail;
@@ -477,9 +624,110 @@ blfHandleOpen(BLFHANDLE h, FILE *fp)
   }
 
   blfStatisticsFromLOGG(&h->mStatistics, &h->mLOGG);
+
+  /* a pipe ends at EOF or after the file size given in the header */
+  if(h->mLOGG.fileSize > h->mLOGG.mHeaderSize) {
+    blfSizedStreamSetSize(&h->mDualStream.fileStream,
+                          h->mLOGG.fileSize - h->mLOGG.mHeaderSize);
+  }
+
+  /*
+   * container buffers and inflate state are reused, two buffers per
+   * pipeline slot are in flight at most
+   */
+  h->mPool = blfBufferPoolCreate(8 * nThreads + 4);
+  h->mInflater = blfInflaterCreate();
+  if((h->mPool == NULL) || (h->mInflater == NULL)) {
+    fprintf(stderr, "blfHandleOpen: out of memory\n");
+    goto fail;
+  }
+  h->mDualStream.memStream.mPool = h->mPool;
+  h->mThreads = nThreads;
+
+  /* read ahead and inflate in parallel for large files */
+  if(   (nThreads > 1)
+     && (h->mLOGG.fileSize >= BLF_PIPELINE_MIN_SIZE)) {
+    h->mPipeline = blfPipelineCreate(&h->mDualStream.fileStream,
+                                     nThreads - 1, h->mPool);
+  }
+  return 1;
+
+fail:
+  blfBufferPoolFree(h->mPool);
+  h->mPool = NULL;
+  blfInflaterFree(h->mInflater);
+  h->mInflater = NULL;
+  return 0;
+}
+
+/*
+ * associate BLFHANDLE with a FILE and read header and statistics,
+ * start read-ahead pipeline if nThreads > 1
+ */
+success_t
+blfHandleOpen(BLFHANDLE h, FILE *fp, unsigned int nThreads)
+{
+  return blfSizedStreamInitFromFile(&h->mDualStream.fileStream, fp)
+      && blfHandleOpenStream(h, nThreads);
+}
+
+/*
+ * associate BLFHANDLE with a read-only mapping of a whole BLF file,
+ * which is released on close or failure
+ */
+success_t
+blfHandleOpenMapped(BLFHANDLE h, void *map, size_t size,
+                    unsigned int nThreads)
+{
+  if(   blfSizedStreamInitFromMapping(&h->mDualStream.fileStream, map, size)
+     && blfHandleOpenStream(h, nThreads)) {
+    return 1;
+  }
+  blfDualStreamClose(&h->mDualStream);
+  return 0;
+}
+
+/*
+ * continue reading with the LOG container at file offset, skipping
+ * nSkip bytes of its payload, and stop reading at file offset end
+ */
+success_t
+blfHandleSeek(BLFHANDLE h, uint64_t offset, uint32_t nSkip, uint64_t end)
+{
+  DualStream *const ds = &h->mDualStream;
+  SizedStream *const fs = &ds->fileStream;
+  VBLObjectHeaderBase base;
+  success_t success;
+
+  /* stop read-ahead and drop the current container */
+  blfPipelineFree(h->mPipeline);
+  h->mPipeline = NULL;
+  if(!blfDualStreamSeek(ds, offset, end))                goto fail;
+  if(offset == end)                                      goto success;
+
+  /* skip objects of the container which start in previous containers */
+  if(nSkip > 0) {
+    h->mPeekFlag = 1;
+    success = blfPeekObjectInternal(h, &base);
+    h->mPeekFlag = 0;
+    if(!success)                                         goto fail;
+    if(base.mObjectType != BL_OBJ_TYPE_LOG_CONTAINER)    goto fail;
+    if(!blfHandleRead(h, 0, NULL, nSkip))                goto fail;
+  }
+
+  /* the pipeline reads a FILE up to its end, so only mappings qualify */
+  if(   (h->mThreads > 1)
+     && (fs->mMap != NULL)
+     && ((size_t)(fs->mEnd - fs->mPos) >= BLF_PIPELINE_MIN_SIZE)) {
+    h->mPipeline = blfPipelineCreate(fs, h->mThreads - 1, h->mPool);
+  }
+
+success:
   return 1;
 
 fail:
+  fprintf(stderr, "blfHandleSeek(): can't seek to container at %lu\n",
+          (unsigned long)offset);
   return 0;
 }
 
@@ -501,6 +749,8 @@ blfFreeHeader(BLFHANDLE hFile, VBLObjectHeader *pBase)
     case BL_OBJ_TYPE_CAN_DRIVER_ERROR:
     case BL_OBJ_TYPE_CAN_ERROR_EXT:
     case BL_OBJ_TYPE_CAN_MESSAGE2:
+    case BL_OBJ_TYPE_CAN_FD_MESSAGE:
+    case BL_OBJ_TYPE_CAN_FD_MESSAGE_64:
       /* no additional memory to be freed */
       break;
     default:
@@ -41,14 +41,28 @@ extern "C" {
 #define BL_LOGG_SIGNATURE 0x47474F4C       /* 'LOGG' */
 
 void      blfMemZero(uint8_t *mem, const size_t n);
+blfInflater_t *blfInflaterCreate(void);
+success_t blfInflaterRun(blfInflater_t *inf,
+                         uint8_t *next_out, uint32_t avail_out,
+                         uint8_t *next_in, uint32_t avail_in,
+                         uint32_t *total_out_ptr);
+void      blfInflaterFree(blfInflater_t *inf);
+success_t blfMemUncompress(uint8_t *next_out, uint32_t avail_out,
+                           uint8_t *next_in, uint32_t avail_in,
+                           uint32_t *total_out_ptr);
 success_t blfHandleIsInitialized(BLFHANDLE h);
 success_t blfPeekObjectInternal(BLFHANDLE hFile, VBLObjectHeaderBase *pBase);
 BLFHANDLE  blfHandleInit(BLFHANDLE this);
-success_t blfHandleOpen(BLFHANDLE h, FILE *fp);
+success_t blfHandleOpen(BLFHANDLE h, FILE *fp, unsigned int nThreads);
+success_t blfHandleOpenMapped(BLFHANDLE h, void *map, size_t size,
+                              unsigned int nThreads);
+success_t blfHandleSeek(BLFHANDLE h, uint64_t offset, uint32_t nSkip,
+                        uint64_t end);
 success_t blfHandleRead(BLFHANDLE h, uint8_t fileOnlyBit, uint8_t *dest_ptr,
                         uint32_t nBytes);
 success_t blfFreeHeader(BLFHANDLE hFile, VBLObjectHeader *pBase);
 success_t blfHandleSkip(BLFHANDLE h, uint32_t nBytes);
+success_t blfHandleSkipPadding(BLFHANDLE h, uint32_t nBytes);
 void      blfVBLObjectHeaderBaseCopy (VBLObjectHeaderBase *const dest,
                                       const VBLObjectHeaderBase *const source);
 success_t blfHandleClose(BLFHANDLE h);
@@ -0,0 +1,429 @@
+/*  blfpipeline.c -- read-ahead and parallel inflate of BLF containers
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blfpipeline.h"
+#include "blfparser.h"
+#include "blfapi.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+
+/* state of a pipeline slot */
+typedef enum {
+  blfJob_free = 0,  /* slot unused */
+  blfJob_read,      /* compressed container read, waiting for inflate */
+  blfJob_inflating, /* worker is inflating */
+  blfJob_done,      /* payload ready */
+  blfJob_failed     /* inflate failed */
+} blfJobState_t;
+
+/*
+ * one top-level object in flight, payloads are either pool buffers or
+ * lie within the file mapping
+ */
+typedef struct {
+  blfJobState_t  state;
+  const uint8_t *input;       /* compressed payload */
+  uint32_t       inputSize;
+  uint8_t       *inputBuffer; /* pool buffer of input, NULL if mapped */
+  const uint8_t *output;      /* payload handed out */
+  uint32_t       outputSize;
+  uint8_t       *outputBuffer;/* pool buffer of output, NULL if mapped */
+} blfJob_t;
+
+struct blfPipeline_s {
+  FILE           *fp;        /* file, NULL if mapped */
+  const uint8_t  *pos;       /* read position in mapping */
+  const uint8_t  *end;       /* end of mapping */
+  blfBufferPool_t *pool;     /* buffers of all jobs */
+  unsigned int    nSlots;
+  blfJob_t       *job;       /* ring of slots */
+  size_t          head;      /* next job to be handed out */
+  size_t          tail;      /* next job to be read */
+  int             eof;       /* reader has finished */
+  int             stop;      /* terminate threads */
+  unsigned int    nWorkers;
+  pthread_t       reader;
+  pthread_t      *worker;
+  pthread_mutex_t mutex;
+  pthread_cond_t  readable;  /* a slot has been freed */
+  pthread_cond_t  inflatable;/* a job waits for inflate or stop */
+  pthread_cond_t  ready;     /* a job is done or reader finished */
+};
+
+/*
+ * read next top-level object from file into job
+ *
+ * returns 1 on success, 0 at end of file or on error
+ */
+static success_t
+blfPipelineReadObject(FILE *fp, blfBufferPool_t *pool, blfJob_t *job)
+{
+  VBLObjectHeaderBaseLOGG header;
+  uint32_t padding;
+  uint8_t *input = NULL;
+  uint8_t *output = NULL;
+
+  if(1 != fread(&header.base, sizeof(header.base), 1, fp)) goto fail;
+  if(header.base.mSignature != BL_OBJ_SIGNATURE)           goto fail;
+  if(header.base.mObjectSize < sizeof(header.base))        goto fail;
+  padding = header.base.mObjectSize & 3;
+
+  if(   (header.base.mObjectType == BL_OBJ_TYPE_LOG_CONTAINER)
+     && (header.base.mObjectSize >= sizeof(header))) {
+    /* LOG container: payload without header and padding */
+    if(1 != fread(&header.compressedflag,
+                  sizeof(header) - sizeof(header.base), 1, fp)) goto fail;
+    job->inputSize = header.base.mObjectSize - sizeof(header);
+    input = blfBufferPoolGet(pool, job->inputSize);
+    if(input == NULL)                                      goto fail;
+    if(   (job->inputSize > 0)
+       && (1 != fread(input, job->inputSize, 1, fp)))       goto fail;
+    if(padding && !blfFileSkip(fp, padding))               goto fail;
+
+    if(header.compressedflag == 2) {
+      job->input = job->inputBuffer = input;
+      job->outputSize = header.deflatebuffersize;
+      job->state = blfJob_read;
+    } else {
+      job->output = job->outputBuffer = input;
+      job->outputSize = job->inputSize;
+      job->state = blfJob_done;
+    }
+  } else {
+    /* any other object: raw bytes including header and padding */
+    job->outputSize = header.base.mObjectSize + padding;
+    output = blfBufferPoolGet(pool, job->outputSize);
+    if(output == NULL)                                     goto fail;
+    memcpy(output, &header.base, sizeof(header.base));
+    memset(output + header.base.mObjectSize, 0, padding);
+    if(   (header.base.mObjectSize > sizeof(header.base))
+       && (1 != fread(output + sizeof(header.base),
+                      header.base.mObjectSize - sizeof(header.base),
+                      1, fp)))                              goto fail;
+
+    if(padding && !blfFileSkip(fp, padding))               goto fail;
+    job->output = job->outputBuffer = output;
+    job->state = blfJob_done;
+  }
+  return 1;
+
+fail:
+  blfBufferPoolPut(pool, input);
+  blfBufferPoolPut(pool, output);
+  return 0;
+}
+
+/*
+ * take next top-level object from the file mapping into job,
+ * payloads are used in place
+ *
+ * returns 1 on success, 0 at end of file or on error
+ */
+static success_t
+blfPipelineMapObject(blfPipeline_t *p, blfJob_t *job)
+{
+  VBLObjectHeaderBaseLOGG header;
+  const size_t left = (size_t)(p->end - p->pos);
+  size_t size;
+
+  if(left < sizeof(header.base))                           goto fail;
+  memcpy(&header.base, p->pos, sizeof(header.base));
+  if(header.base.mSignature != BL_OBJ_SIGNATURE)           goto fail;
+  if(header.base.mObjectSize < sizeof(header.base))        goto fail;
+  if(header.base.mObjectSize > left)                       goto fail;
+
+  /* padding of the last object may be missing */
+  size = BLFMIN(header.base.mObjectSize + (header.base.mObjectSize & 3),
+                left);
+
+  if(   (header.base.mObjectType == BL_OBJ_TYPE_LOG_CONTAINER)
+     && (header.base.mObjectSize >= sizeof(header))) {
+    /* LOG container: payload without header and padding */
+    memcpy(&header, p->pos, sizeof(header));
+    if(header.compressedflag == 2) {
+      job->input = p->pos + sizeof(header);
+      job->inputSize = header.base.mObjectSize - sizeof(header);
+      job->outputSize = header.deflatebuffersize;
+      job->state = blfJob_read;
+    } else {
+      job->output = p->pos + sizeof(header);
+      job->outputSize = header.base.mObjectSize - sizeof(header);
+      job->state = blfJob_done;
+    }
+  } else {
+    /* any other object: raw bytes including header and padding */
+    job->output = p->pos;
+    job->outputSize = size;
+    job->state = blfJob_done;
+  }
+  p->pos += size;
+  return 1;
+
+fail:
+  return 0;
+}
+
+/* reader thread: read objects into free slots */
+static void *
+blfPipelineReader(void *arg)
+{
+  blfPipeline_t *p = (blfPipeline_t *)arg;
+
+  pthread_mutex_lock(&p->mutex);
+  while(!p->stop) {
+    blfJob_t *job;
+    success_t success;
+
+    if(p->tail - p->head == p->nSlots) {
+      pthread_cond_wait(&p->readable, &p->mutex);
+      continue;
+    }
+    job = &p->job[p->tail % p->nSlots];
+    pthread_mutex_unlock(&p->mutex);
+
+    if(p->fp != NULL) {
+      success = blfPipelineReadObject(p->fp, p->pool, job);
+    } else {
+      success = blfPipelineMapObject(p, job);
+    }
+
+    pthread_mutex_lock(&p->mutex);
+    if(!success) break;
+    p->tail++;
+    if(job->state == blfJob_read) {
+      pthread_cond_signal(&p->inflatable);
+    } else {
+      pthread_cond_signal(&p->ready);
+    }
+  }
+  p->eof = 1;
+  pthread_cond_broadcast(&p->ready);
+  pthread_mutex_unlock(&p->mutex);
+  return NULL;
+}
+
+/* worker thread: inflate containers in file order */
+static void *
+blfPipelineWorker(void *arg)
+{
+  blfPipeline_t *p = (blfPipeline_t *)arg;
+  blfInflater_t *inf = blfInflaterCreate();
+
+  pthread_mutex_lock(&p->mutex);
+  while(!p->stop) {
+    blfJob_t *job = NULL;
+    success_t success;
+    size_t i;
+
+    /* oldest job awaiting inflate */
+    for(i = p->head; i < p->tail; i++) {
+      job = &p->job[i % p->nSlots];
+      if(job->state == blfJob_read) break;
+      job = NULL;
+    }
+    if(job == NULL) {
+      pthread_cond_wait(&p->inflatable, &p->mutex);
+      continue;
+    }
+    job->state = blfJob_inflating;
+    pthread_mutex_unlock(&p->mutex);
+
+    job->output = job->outputBuffer =
+      blfBufferPoolGet(p->pool, job->outputSize);
+    success = (inf != NULL) && (job->outputBuffer != NULL)
+           && blfInflaterRun(inf, job->outputBuffer, job->outputSize,
+                             (uint8_t *)job->input, job->inputSize, NULL);
+    blfBufferPoolPut(p->pool, job->inputBuffer);
+    job->input = job->inputBuffer = NULL;
+
+    pthread_mutex_lock(&p->mutex);
+    job->state = success ? blfJob_done : blfJob_failed;
+    pthread_cond_broadcast(&p->ready);
+  }
+  pthread_mutex_unlock(&p->mutex);
+  blfInflaterFree(inf);
+  return NULL;
+}
+
+/* stop and join threads, return buffers to the pool */
+void
+blfPipelineFree(blfPipeline_t *p)
+{
+  unsigned int i;
+
+  if(p == NULL) return;
+
+  pthread_mutex_lock(&p->mutex);
+  p->stop = 1;
+  pthread_cond_broadcast(&p->readable);
+  pthread_cond_broadcast(&p->inflatable);
+  pthread_mutex_unlock(&p->mutex);
+
+  pthread_join(p->reader, NULL);
+  for(i = 0; i < p->nWorkers; i++) pthread_join(p->worker[i], NULL);
+
+  for(i = 0; i < p->nSlots; i++) {
+    blfBufferPoolPut(p->pool, p->job[i].inputBuffer);
+    blfBufferPoolPut(p->pool, p->job[i].outputBuffer);
+  }
+  pthread_cond_destroy(&p->ready);
+  pthread_cond_destroy(&p->inflatable);
+  pthread_cond_destroy(&p->readable);
+  pthread_mutex_destroy(&p->mutex);
+  free(p->worker);
+  free(p->job);
+  free(p);
+}
+
+/*
+ * start pipeline on the objects following the current position of a
+ * file or mapped stream, buffers are taken from pool and handed out to
+ * the caller
+ *
+ * returns NULL if no thread could be started, the stream position is
+ * unchanged in this case
+ */
+blfPipeline_t *
+blfPipelineCreate(SizedStream *s, unsigned int nThreads,
+                  blfBufferPool_t *pool)
+{
+  blfPipeline_t *p;
+
+  if(nThreads == 0) nThreads = 1;
+  if((s->mFile == NULL) && (s->mMap == NULL)) goto fail;
+
+  p = (blfPipeline_t *)calloc(1, sizeof(*p));
+  if(p == NULL) goto fail;
+  p->fp = s->mFile;
+  p->pos = s->mPos;
+  p->end = s->mEnd;
+  p->pool = pool;
+  p->nSlots = 4 * nThreads;
+  p->job = (blfJob_t *)calloc(p->nSlots, sizeof(*p->job));
+  p->worker = (pthread_t *)calloc(nThreads, sizeof(*p->worker));
+  if((p->job == NULL) || (p->worker == NULL)) goto fail_alloc;
+
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->readable, NULL);
+  pthread_cond_init(&p->inflatable, NULL);
+  pthread_cond_init(&p->ready, NULL);
+
+  for(p->nWorkers = 0; p->nWorkers < nThreads; p->nWorkers++) {
+    if(0 != pthread_create(&p->worker[p->nWorkers], NULL,
+                           blfPipelineWorker, p)) break;
+  }
+  if(   (p->nWorkers == 0)
+     || (0 != pthread_create(&p->reader, NULL, blfPipelineReader, p))) {
+    /* no reader thread: let the workers terminate */
+    pthread_mutex_lock(&p->mutex);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->inflatable);
+    pthread_mutex_unlock(&p->mutex);
+    while(p->nWorkers > 0) pthread_join(p->worker[--p->nWorkers], NULL);
+    pthread_cond_destroy(&p->ready);
+    pthread_cond_destroy(&p->inflatable);
+    pthread_cond_destroy(&p->readable);
+    pthread_mutex_destroy(&p->mutex);
+    goto fail_alloc;
+  }
+  return p;
+
+fail_alloc:
+  free(p->worker);
+  free(p->job);
+  free(p);
+fail:
+  return NULL;
+}
+
+/*
+ * get payload of next top-level object
+ *
+ * dataPtr   payload
+ * sizePtr   size of payload
+ * bufPtr    pool buffer of payload, which the caller returns to the
+ *           pool, or NULL if the payload lies within the mapping
+ *
+ * returns 0 at end of file or on error
+ */
+success_t
+blfPipelineNext(blfPipeline_t *p, const uint8_t **dataPtr,
+                uint32_t *sizePtr, uint8_t **bufPtr)
+{
+  blfJob_t *job;
+  success_t success = 0;
+
+  pthread_mutex_lock(&p->mutex);
+  while(1) {
+    job = &p->job[p->head % p->nSlots];
+    if(p->head < p->tail) {
+      if((job->state == blfJob_done) || (job->state == blfJob_failed)) break;
+    } else if(p->eof) {
+      goto done;
+    }
+    pthread_cond_wait(&p->ready, &p->mutex);
+  }
+
+  if(job->state == blfJob_failed) {
+    fprintf(stderr, "blfInflaterRun failed\n");
+  } else {
+    *dataPtr = job->output;
+    *sizePtr = job->outputSize;
+    *bufPtr = job->outputBuffer;
+    job->outputBuffer = NULL;
+    success = 1;
+  }
+  blfBufferPoolPut(p->pool, job->outputBuffer);
+  job->output = job->outputBuffer = NULL;
+  job->state = blfJob_free;
+  p->head++;
+  pthread_cond_signal(&p->readable);
+
+done:
+  pthread_mutex_unlock(&p->mutex);
+  return success;
+}
+
+#else
+
+/* without threads, containers are inflated by the parser */
+blfPipeline_t *
+blfPipelineCreate(SizedStream *s, unsigned int nThreads,
+                  blfBufferPool_t *pool)
+{
+  return NULL;
+}
+
+success_t
+blfPipelineNext(blfPipeline_t *p, const uint8_t **dataPtr,
+                uint32_t *sizePtr, uint8_t **bufPtr)
+{
+  return 0;
+}
+
+void
+blfPipelineFree(blfPipeline_t *p)
+{
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef INCLUDE_BLFPIPELINE_H
+#define INCLUDE_BLFPIPELINE_H
+
+/*  blfpipeline.h -- declarations for blfpipeline
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+#include <stdio.h>
+
+#include "blfstream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* minimum file size for read-ahead with parallel inflate */
+#define BLF_PIPELINE_MIN_SIZE (16u * 1024u * 1024u)
+
+/*
+ * Read-ahead pipeline for the objects following the LOGG header
+ *
+ * A reader thread reads the top-level objects of the file, a pool of
+ * workers inflates the LOG containers among them. The payload of each
+ * container, or the raw bytes of any other top-level object, is handed
+ * out in file order. The concatenation of these buffers is the object
+ * stream the parser sees without the pipeline. For a mapped file,
+ * payloads stored uncompressed are handed out in place.
+ */
+typedef struct blfPipeline_s blfPipeline_t;
+
+blfPipeline_t *blfPipelineCreate(SizedStream *s, unsigned int nThreads,
+                                 blfBufferPool_t *pool);
+success_t blfPipelineNext(blfPipeline_t *p, const uint8_t **dataPtr,
+                          uint32_t *sizePtr, uint8_t **bufPtr);
+void blfPipelineFree(blfPipeline_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
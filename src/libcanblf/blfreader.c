@@ -17,11 +17,15 @@
 #include "cantools_config.h"
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
 #include "dbctypes.h"
 #include "blfapi.h"
+#include "blfindex.h"
+#include "blfreader.h"
 #include "measurement.h"
 
 extern int verbose_flag;
@@ -33,7 +37,7 @@ blfSystemTimePrint(SYSTEMTIME *const s)
   char *dow[] = {
       "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
   };
-  printf("%s %04d-%02d-%02d %02d:%02d:%02d.%03d",
+  fprintf(stderr, "%s %04d-%02d-%02d %02d:%02d:%02d.%03d",
    (s->wDayOfWeek < 7) ? dow[s->wDayOfWeek < 7 ]: "???",
    s->wYear,
    s->wMonth,
@@ -49,18 +53,28 @@ blfCANMessageDump(const canMessage_t* canMessage)
 {
   uint8_t i;
 
-  printf("MSG %ld.%09ld: %d 0x%04x %d [ ",
+  fprintf(stderr, "MSG %ld.%09ld: %d 0x%04x %d [ ",
           canMessage->t.tv_sec,
           canMessage->t.tv_nsec,
           canMessage->bus,
           canMessage->id,
           canMessage->dlc);
-  for(i = 0; i < canMessage->dlc; i++) {
-    printf("%02x ", canMessage->byte_arr[i]);
+  for(i = 0; i < canMessage->len; i++) {
+    fprintf(stderr, "%02x ", canMessage->byte_arr[i]);
   }
-  puts("]");
+  fputs("]\n", stderr);
 }
 
+/* CAN message objects, read in place or copied */
+typedef union {
+  VBLObjectHeaderBase base;
+  VBLObjectHeader     header;
+  VBLCANMessage       can;
+  VBLCANMessage2      can2;
+  VBLCANFDMessage     canFd;
+  VBLCANFDMessage64   canFd64;
+} blfCANObject_t;
+
 static void
 blfCANMessageFromVBLCANMessage (canMessage_t* canMessage,
                                 const VBLCANMessage* message)
@@ -68,27 +82,79 @@ blfCANMessageFromVBLCANMessage (canMessage_t* canMessage,
   /* copy data */
   canMessage->bus = message->mChannel;
   canMessage->dlc = message->mDLC;
-  memcpy(canMessage->byte_arr, message->mData, canMessage->dlc);
+  canMessage->len = canMessage_dlcToLen(message->mDLC, 0);
+  canMessage->flags = 0;
+  memcpy(canMessage->byte_arr, message->mData, canMessage->len);
+  canMessage->id = (uint32)message->mID;
+}
+
+static void
+blfCANMessageFromVBLCANFDMessage (canMessage_t* canMessage,
+                                  const VBLCANFDMessage* message)
+{
+  const uint8_t fdFlags = message->mCANFDFlags;
+
+  canMessage->flags = 0;
+  if(fdFlags & BL_CANFD_FLAG_EDL) {
+    canMessage->flags = CANMESSAGE_FLAG_FD;
+    if(fdFlags & BL_CANFD_FLAG_BRS) canMessage->flags |= CANMESSAGE_FLAG_BRS;
+    if(fdFlags & BL_CANFD_FLAG_ESI) canMessage->flags |= CANMESSAGE_FLAG_ESI;
+  }
+
+  /* copy data */
+  canMessage->bus = message->mChannel;
+  canMessage->dlc = message->mDLC;
+  canMessage->len = canMessage_dlcToLen(message->mDLC,
+                                        fdFlags & BL_CANFD_FLAG_EDL);
+  memcpy(canMessage->byte_arr, message->mData, canMessage->len);
+  canMessage->id = (uint32)message->mID;
+}
+
+/* nData is the number of data bytes present in the object */
+static void
+blfCANMessageFromVBLCANFDMessage64 (canMessage_t* canMessage,
+                                    const VBLCANFDMessage64* message,
+                                    size_t nData)
+{
+  const uint32_t fdFlags = message->mFlags;
+
+  canMessage->flags = 0;
+  if(fdFlags & BL_CANFD64_FLAG_EDL) {
+    canMessage->flags = CANMESSAGE_FLAG_FD;
+    if(fdFlags & BL_CANFD64_FLAG_BRS) canMessage->flags |= CANMESSAGE_FLAG_BRS;
+    if(fdFlags & BL_CANFD64_FLAG_ESI) canMessage->flags |= CANMESSAGE_FLAG_ESI;
+  }
+
+  /* copy data, the payload may be shorter than the DLC */
+  canMessage->bus = message->mChannel;
+  canMessage->dlc = message->mDLC;
+  canMessage->len = canMessage_dlcToLen(message->mDLC,
+                                        fdFlags & BL_CANFD64_FLAG_EDL);
+  if(canMessage->len > message->mValidDataBytes) {
+    canMessage->len = message->mValidDataBytes;
+  }
+  if(canMessage->len > nData) canMessage->len = nData;
+  memcpy(canMessage->byte_arr, message->mData, canMessage->len);
   canMessage->id = (uint32)message->mID;
 }
 
 static void
-blfVBLCANMessageParseTime(const VBLCANMessage* message, time_t *sec,
-                          uint32 *nsec)
+blfVBLObjectHeaderParseTime(const VBLObjectHeader* header, time_t *sec,
+                            uint32 *nsec)
 {
   const uint64_t C_1E9  = 1000000000ULL;
   const uint64_t C_1E5  =     100000ULL;
   const uint64_t C_1E4  =      10000ULL;
-  const uint32_t flags = message->mHeader.mObjectFlags;
+  const uint32_t flags = header->mObjectFlags;
   
   if (flags & BL_OBJ_FLAG_TIME_TEN_MICS) {
     /* 10 microsecond increments */
-    *sec   = message->mHeader.mObjectTimeStamp / C_1E5;
-    *nsec = (message->mHeader.mObjectTimeStamp % C_1E5) * C_1E4;
+    *sec   = header->mObjectTimeStamp / C_1E5;
+    *nsec = (header->mObjectTimeStamp % C_1E5) * C_1E4;
   } else if (flags & BL_OBJ_FLAG_TIME_ONE_NANS) {
     /* 1 nanosecond increments */
-    *sec  = message->mHeader.mObjectTimeStamp / C_1E9;
-    *nsec = message->mHeader.mObjectTimeStamp % C_1E9;
+    *sec  = header->mObjectTimeStamp / C_1E9;
+    *nsec = header->mObjectTimeStamp % C_1E9;
   } else { /* unknown time format - emit zero time stamp */
     *sec = 0;
     *nsec = 0;
@@ -96,83 +162,277 @@ blfVBLCANMessageParseTime(const VBLCANMessage* message, time_t *sec,
 }
 
 /*
- * Parser for BLF files.
+ * check for the BLF file signature
  *
- * mFile       FILE pointer of input file
- * msgRxCb  callback function for received messages
- * cbData   pointer to opaque callback data
+ * head     first n bytes of the file
+ *
+ * returns 1 for BLF files, 0 otherwise
  */
-void blfReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+int blfReader_probe(const void *head, size_t n)
+{
+  return (n >= 4) && !memcmp(head, "LOGG", 4);
+}
+
+/* reader state */
+struct blfReader_s {
+  BLFHANDLE   h;
+  const char *path;      /* file name for the container index, or NULL */
+  blfIndex_t *index;     /* container index, loaded on first seek */
+  uint64_t    startTime; /* time range in nanoseconds */
+  uint64_t    endTime;
+  int         cacheIndex; /* keep container index in a sidecar file */
+  success_t   success;   /* no read error so far */
+};
+
+/*
+ * open BLF file for reading batches of messages
+ *
+ * If the file name is given, its container index is used by
+ * blfReader_setTimeRange() and blfReader_seekTime().
+ *
+ * fp       FILE pointer of input file, closed by blfReader_close()
+ * path     file name of input file or NULL
+ *
+ * returns NULL on error
+ */
+blfReader_t *blfReader_open(FILE *fp, const char *path)
 {
-  VBLObjectHeaderBase base;
-  VBLCANMessage message;
   VBLFileStatisticsEx statistics = { sizeof(statistics) };
-  canMessage_t canMessage;
-  BLFHANDLE h;
-  success_t success;
+  blfReader_t *r;
+
+  r = calloc(1, sizeof(*r));
+  if(r == NULL) {
+    fprintf(stderr, "blfReader_open(): out of memory\n");
+    fclose(fp);
+    return NULL;
+  }
+  r->path = path;
+  r->endTime = UINT64_MAX;
+  r->success = 1;
 
   /* get header */
-  h = blfCreateFile(fp);
-  if(h == NULL) {
+  r->h = blfCreateFile(fp);
+  if(r->h == NULL) {
     fprintf(stderr, "blfReader_processFile: cannot open file\n");
     goto read_error;
   }
 
   /* diagnose header */
-  blfGetFileStatisticsEx(h, &statistics);
+  blfGetFileStatisticsEx(r->h, &statistics);
 
   /* print some file statistics */
   if(verbose_flag) {
-    printf("BLF Start  : ");
+    fprintf(stderr, "BLF Start  : ");
     blfSystemTimePrint(&statistics.mMeasurementStartTime);
-    printf("\nBLF End    : ");
+    fprintf(stderr, "\nBLF End    : ");
     blfSystemTimePrint(&statistics.mLastObjectTime);
-    printf("\nObject Count: %u\n", statistics.mObjectCount);
+    fprintf(stderr, "\nObject Count: %u\n", statistics.mObjectCount);
+  }
+  return r;
+
+read_error:
+  fprintf(stderr,"error reading BLF file, aborting\n");
+  free(r);
+  return NULL;
+}
+
+/*
+ * restrict reading to the messages of a time range
+ *
+ * If the file name is known, only the containers of the time range are
+ * read.
+ *
+ * returns 0 on a read error
+ */
+success_t blfReader_setTimeRange(blfReader_t *r, const timeRange_t *range)
+{
+  r->startTime = range->startTime;
+  r->endTime = range->endTime;
+  r->cacheIndex = range->cacheIndex;
+  if((r->path != NULL) && ((r->startTime > 0) || (r->endTime < UINT64_MAX))) {
+    blfReader_seekTime(r, r->startTime);
   }
+  return r->success;
+}
+
+/*
+ * continue reading with the container holding the first message at
+ * or after time t in nanoseconds, earlier messages of this container
+ * are read as well
+ *
+ * Seeking requires the file name and its container index; the
+ * position is not changed if the index is not available.
+ *
+ * returns 1 on success
+ */
+success_t blfReader_seekTime(blfReader_t *r, uint64_t t)
+{
+  if(r->path == NULL) return 0;
+  if(r->index == NULL) {
+    r->index = blfIndexOpen(r->path, r->cacheIndex);
+    if(r->index == NULL) return 0;
+  }
+  if(t < r->startTime) t = r->startTime;
+  r->success = blfIndexSeek(r->h, r->index, t, r->endTime);
+  return r->success;
+}
+
+/*
+ * parse next messages
+ *
+ * message  caller-provided array of size entries
+ *
+ * returns the number of messages, 0 at end of file
+ */
+unsigned int blfReader_nextBatch(blfReader_t *r, canMessage_t *message,
+                                 unsigned int size)
+{
+  const BLFHANDLE h = r->h;
+  VBLObjectHeaderBase base;
+  blfCANObject_t object;
+  const blfCANObject_t *objectPtr;
+  canMessage_t *canMessage;
+  msgBatch_t batch;
+
+  msgBatch_init(&batch, message, size, NULL, NULL);
+  while(   !msgBatch_full(&batch)
+        && r->success && blfPeekObject(h, &base)) {
+    size_t minSize;
 
-  success = 1;
-  while(success && blfPeekObject(h, &base)) {
     switch(base.mObjectType) {
       case BL_OBJ_TYPE_CAN_MESSAGE:
-        message.mHeader.mBase = base;
-        success = blfReadObjectSecure(h, &message.mHeader.mBase,
-                                      sizeof(message));
-        if(success) {
-          /* diagnose data */
-          if(message.mDLC > 8) {
-            fprintf(stderr, "invalid CAN message: DLC > 8\n");
-            goto read_error;
-          }
-
-          /* translate VBLCANMessage to message structure */
-          blfCANMessageFromVBLCANMessage(&canMessage, &message);
-          blfVBLCANMessageParseTime(&message, &canMessage.t.tv_sec,
-                                    &canMessage.t.tv_nsec);
-
-          if(debug_flag) {
-            blfCANMessageDump(&canMessage);
-          }
-
-          /* invoke canMessage receive callback function */
-          msgRxCb(&canMessage, cbData);
-
-          /* free allocated memory */
-          blfFreeObject(h, &message.mHeader.mBase);
-        }
+      case BL_OBJ_TYPE_CAN_MESSAGE2:
+        minSize = sizeof(VBLCANMessage);
+        break;
+      case BL_OBJ_TYPE_CAN_FD_MESSAGE:
+        minSize = sizeof(VBLCANFDMessage);
+        break;
+      case BL_OBJ_TYPE_CAN_FD_MESSAGE_64:
+        minSize = offsetof(VBLCANFDMessage64, mData);
         break;
       default:
         /* skip all other objects */
-        success = blfSkipObject(h, &base);
+        r->success = blfSkipObject(h, &base);
         if(debug_flag) {
-          printf("skipping object type = %d\n", base.mObjectType);
+          fprintf(stderr, "skipping object type = %d\n", base.mObjectType);
         }
-        break;
+        continue;
+    }
+
+    /* read in place, copy only objects spanning two containers */
+    objectPtr = (const blfCANObject_t *)
+      blfGetObjectPointer(h, &base, minSize);
+    if(objectPtr == NULL) {
+      object.base = base;
+      r->success = blfReadObjectSecure(h, &object.base, sizeof(object));
+      objectPtr = &object;
+    }
+    if(r->success) {
+      uint64_t t;
+
+      /* translate CAN message object to message structure */
+      canMessage = msgBatch_next(&batch);
+      switch(base.mObjectType) {
+        case BL_OBJ_TYPE_CAN_FD_MESSAGE:
+          blfCANMessageFromVBLCANFDMessage(canMessage, &objectPtr->canFd);
+          break;
+        case BL_OBJ_TYPE_CAN_FD_MESSAGE_64:
+          blfCANMessageFromVBLCANFDMessage64(canMessage,
+            &objectPtr->canFd64,
+            (objectPtr == &object) ? sizeof(object.canFd64.mData)
+                                   : base.mObjectSize - minSize);
+          break;
+        default:
+          /* CAN_MESSAGE2 extends CAN_MESSAGE */
+          blfCANMessageFromVBLCANMessage(canMessage, &objectPtr->can);
+          break;
+      }
+      blfVBLObjectHeaderParseTime(&objectPtr->header, &canMessage->t.tv_sec,
+                                  &canMessage->t.tv_nsec);
+
+      if(debug_flag) {
+        blfCANMessageDump(canMessage);
+      }
+
+      /* append canMessage to batch, if within time range */
+      t =   (uint64_t)canMessage->t.tv_sec * 1000000000u
+          + canMessage->t.tv_nsec;
+      if((t >= r->startTime) && (t <= r->endTime)) {
+        msgBatch_commit(&batch);
+      }
+    }
+    if(objectPtr != &object) {
+      /* advance behind object read in place */
+      r->success = blfSkipObject(h, &base);
+    } else if(r->success) {
+      /* free allocated memory */
+      blfFreeObject(h, &object.base);
     }
   }
-  blfCloseHandle(h);
-  return;
+  return batch.n;
+}
 
-read_error:
-  fprintf(stderr,"error reading BLF file, aborting\n");
-  return;
+/* close input file and free reader */
+void blfReader_close(blfReader_t *r)
+{
+  blfCloseHandle(r->h);
+  if(r->index != NULL) blfIndexFree(r->index);
+  free(r);
+}
+
+/*
+ * Parser for the messages of a time range in BLF files.
+ *
+ * fp       FILE pointer of input file
+ * path     file name of input file for the container index, or NULL
+ * range    time range of messages
+ * batch    batch of received messages, flushed at end of file
+ */
+void blfReader_processFileRange(FILE *fp, const char *path,
+                                const timeRange_t *range, msgBatch_t *batch)
+{
+  blfReader_t *r = blfReader_open(fp, path);
+
+  if(r != NULL) {
+    if(!blfReader_setTimeRange(r, range)) {
+      fprintf(stderr,"error reading BLF file, aborting\n");
+    } else {
+      while((batch->n = blfReader_nextBatch(r, batch->message,
+                                            batch->size)) > 0) {
+        msgBatch_flush(batch);
+      }
+    }
+    blfReader_close(r);
+  }
+}
+
+/*
+ * Parser for BLF files.
+ *
+ * fp       FILE pointer of input file
+ * batch    batch of received messages, flushed at end of file
+ */
+void blfReader_processFileBatch(FILE *fp, msgBatch_t *batch)
+{
+  static const timeRange_t all = { 0, UINT64_MAX, 0 };
+
+  blfReader_processFileRange(fp, NULL, &all, batch);
+}
+
+/*
+ * Parser for BLF files, per-message interface.
+ *
+ * fp       FILE pointer of input file
+ * msgRxCb  callback function for received messages
+ * cbData   pointer to opaque callback data
+ */
+void blfReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+{
+  canMessage_t message[MSGBATCH_ADAPTER_SIZE];
+  msgRxAdapter_t adapter = { msgRxCb, cbData };
+  msgBatch_t batch;
+
+  msgBatch_init(&batch, message, MSGBATCH_ADAPTER_SIZE,
+                msgRxAdapter_batchCb, &adapter);
+  blfReader_processFileBatch(fp, &batch);
 }
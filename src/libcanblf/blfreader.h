@@ -29,9 +29,24 @@
 #include <stdio.h>
 
 #include "dbctypes.h"
+#include "blfapi.h"
 #include "measurement.h"
 
+/* pull-based reader */
+typedef struct blfReader_s blfReader_t;
+
+blfReader_t *blfReader_open(FILE *fp, const char *path);
+unsigned int blfReader_nextBatch(blfReader_t *r, canMessage_t *message,
+                                 unsigned int size);
+success_t    blfReader_setTimeRange(blfReader_t *r, const timeRange_t *range);
+success_t    blfReader_seekTime(blfReader_t *r, uint64_t t);
+void         blfReader_close(blfReader_t *r);
+
 /* blfRead function */
+int  blfReader_probe(const void *head, size_t n);
+void blfReader_processFileRange(FILE *fp, const char *path,
+                                const timeRange_t *range, msgBatch_t *batch);
+void blfReader_processFileBatch(FILE *fp, msgBatch_t *batch);
 void blfReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData);
 
 #ifdef __cplusplus
@@ -18,12 +18,156 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include "blfstream.h"
 
+/********************************************************************
+ * blfBufferPool*: reusable buffers
+ ********************************************************************/
+
+/* header in front of each pool buffer */
+typedef union {
+  size_t   capacity;
+  uint64_t align;
+  double   alignDouble;
+} blfBufferHeader;
+
+struct blfBufferPool_s {
+  unsigned int     nFree;    /* number of free buffers */
+  unsigned int     maxFree;  /* free buffers kept */
+  uint8_t        **free;     /* free buffers */
+  size_t           largest;  /* largest request seen */
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t  mutex;
+#endif
+};
+
+static blfBufferHeader *
+blfBufferHeaderOf(uint8_t *buffer)
+{
+  return (blfBufferHeader *)buffer - 1;
+}
+
+blfBufferPool_t *
+blfBufferPoolCreate(unsigned int maxFree)
+{
+  blfBufferPool_t *pool = (blfBufferPool_t *)malloc(sizeof(*pool));
+
+  if(pool == NULL) goto fail;
+  pool->nFree = 0;
+  pool->maxFree = maxFree;
+  pool->largest = 0;
+  pool->free = (uint8_t **)malloc(maxFree * sizeof(*pool->free));
+  if(pool->free == NULL) goto fail_free;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_init(&pool->mutex, NULL);
+#endif
+  return pool;
+
+fail_free:
+  free(pool);
+fail:
+  return NULL;
+}
+
+/* get buffer of at least size bytes, NULL if out of memory */
+uint8_t *
+blfBufferPoolGet(blfBufferPool_t *pool, size_t size)
+{
+  blfBufferHeader *header = NULL;
+  size_t capacity;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&pool->mutex);
+#endif
+  if(size > pool->largest) pool->largest = size;
+  capacity = pool->largest;
+  if(pool->nFree > 0) {
+    header = blfBufferHeaderOf(pool->free[--pool->nFree]);
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&pool->mutex);
+#endif
+
+  if((header == NULL) || (header->capacity < size)) {
+    /* grow to the largest request, reallocating is rare */
+    blfBufferHeader *newHeader =
+      (blfBufferHeader *)realloc(header, sizeof(*header) + capacity);
+
+    if(newHeader == NULL) {
+      free(header);
+      return NULL;
+    }
+    header = newHeader;
+    header->capacity = capacity;
+  }
+  return (uint8_t *)(header + 1);
+}
+
+/* return buffer to pool */
+void
+blfBufferPoolPut(blfBufferPool_t *pool, uint8_t *buffer)
+{
+  if(buffer == NULL) return;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&pool->mutex);
+#endif
+  if(pool->nFree < pool->maxFree) {
+    pool->free[pool->nFree++] = buffer;
+    buffer = NULL;
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&pool->mutex);
+#endif
+
+  /* pool is full */
+  if(buffer != NULL) free(blfBufferHeaderOf(buffer));
+}
+
+void
+blfBufferPoolFree(blfBufferPool_t *pool)
+{
+  if(pool == NULL) return;
+
+  while(pool->nFree > 0) {
+    free(blfBufferHeaderOf(pool->free[--pool->nFree]));
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_destroy(&pool->mutex);
+#endif
+  free(pool->free);
+  free(pool);
+}
+
 /********************************************************************
  * blfFile*: Low-level file operations
  ********************************************************************/
+/* skip nBytes, files which can't seek like pipes are read instead */
+success_t
+blfFileSkip(FILE *fp, size_t nBytes)
+{
+  uint8_t buffer[4096];
+
+  if(0 == fseek(fp, (long)nBytes, SEEK_CUR)) return 1;
+  while(nBytes > 0) {
+    size_t n = BLFMIN(nBytes, sizeof(buffer));
+
+    if(n != fread(buffer, (size_t)1, n, fp)) return 0;
+    nBytes -= n;
+  }
+  return 1;
+}
+
 static success_t
 blfFileReadOrSkip(FILE *fp, void *dest, size_t nBytes)
 {
@@ -31,7 +175,7 @@ blfFileReadOrSkip(FILE *fp, void *dest, size_t nBytes)
     size_t bytesRead = fread(dest, (size_t)1, nBytes, fp);
     return (!ferror(fp) && (nBytes == bytesRead));
   } else {
-    return 0 == fseek(fp, nBytes, SEEK_CUR);
+    return blfFileSkip(fp, nBytes);
   }
 }
 
@@ -64,6 +208,37 @@ blfSizedStreamInit(SizedStream *s)
   s->mFile = NULL;
   s->mBytesLeft = 0;
   s->mBuffer = NULL;
+  s->mPos = NULL;
+  s->mEnd = NULL;
+  s->mPool = NULL;
+  s->mBorrowed = 0;
+  s->mMap = NULL;
+  s->mMapSize = 0;
+  s->mUnsized = 0;
+  s->mBytesAfter = 0;
+}
+
+/* free buffer of a memory-based stream or return it to its pool */
+static void
+blfSizedStreamReleaseBuffer(SizedStream *s)
+{
+  if(s->mBorrowed) {
+    /* memory belongs to a mapping */
+  } else if(s->mPool != NULL) {
+    blfBufferPoolPut(s->mPool, s->mBuffer);
+  } else {
+    free(s->mBuffer);
+  }
+  s->mBuffer = NULL;
+  s->mPos = NULL;
+  s->mEnd = NULL;
+}
+
+/* cursor of a memory-based or mapped stream */
+static int
+blfSizedStreamIsMemory(const SizedStream *const s)
+{
+  return (s->mBuffer != NULL) || (s->mMap != NULL);
 }
 
 int
@@ -75,7 +250,23 @@ blfSizedStreamIsEmpty(const SizedStream *const s)
 int
 blfSizedStreamIsOpen(const SizedStream *const s)
 {
-  return (s->mFile != NULL);
+  return (s->mFile != NULL) || blfSizedStreamIsMemory(s);
+}
+
+/*
+ * pointer into a memory-based or mapped stream, for nBehind bytes
+ * before and nAhead bytes after the read position. Returns NULL if the
+ * range is not within the memory or if the stream is file-based.
+ */
+const uint8_t *
+blfSizedStreamPeek(const SizedStream *const s, size_t nBehind, size_t nAhead)
+{
+  const uint8_t *begin = (s->mBuffer != NULL) ? s->mBuffer : s->mMap;
+
+  if(begin == NULL) return NULL;
+  if((size_t)(s->mPos - begin) < nBehind) return NULL;
+  if((size_t)(s->mEnd - s->mPos) < nAhead) return NULL;
+  return s->mPos - nBehind;
 }
 
 
@@ -86,24 +277,39 @@ blfSizedStreamBytesLeft(const SizedStream *const s)
 }
 
 static success_t
-blfSizedStreamReadOrSkip(const SizedStream *const s, void *const dest, const size_t nBytes)
+blfSizedStreamReadOrSkip(SizedStream *const s, void *const dest, const size_t nBytes)
 {
+  if(blfSizedStreamIsMemory(s)) {
+    /* memory-based or mapped stream: copy and advance cursor */
+    if(nBytes > (size_t)(s->mEnd - s->mPos)) return 0;
+    if(dest != NULL) memcpy(dest, s->mPos, nBytes);
+    s->mPos += nBytes;
+    return 1;
+  }
+  if(s->mFile == NULL) return 0; /* drained and closed */
   return blfFileReadOrSkip(s->mFile, dest, nBytes);
 }
 
 success_t
 blfSizedStreamInitFromMem(SizedStream *const s, void *const buffer, const size_t size)
 {
-  s->mFile = fmemopen(buffer, size, "r");
-  if(s->mFile != NULL) {
-    s->mBuffer = buffer;
-    s->mBytesLeft = size;
-    return 1;
-  } else {
-    s->mBytesLeft = 0;
-    s->mBytesLeft = 0;
-    return 0;
-  }
+  s->mFile = NULL;
+  s->mBuffer = buffer;
+  s->mPos = buffer;
+  s->mEnd = s->mPos + size;
+  s->mBytesLeft = size;
+  s->mBorrowed = 0;
+  return 1;
+}
+
+/* memory-based stream on memory owned by someone else, e.g. a mapping */
+success_t
+blfSizedStreamInitFromView(SizedStream *const s, const void *const data,
+                           const size_t size)
+{
+  blfSizedStreamInitFromMem(s, (void *)data, size);
+  s->mBorrowed = 1;
+  return 1;
 }
 
 static success_t
@@ -114,9 +320,16 @@ blfSizedStreamClose(SizedStream * const s)
     s->mFile = NULL;
   }
   if(s->mBuffer != NULL) {
-    free(s->mBuffer);
-    s->mBuffer = NULL;
+    blfSizedStreamReleaseBuffer(s);
+  }
+#ifdef HAVE_MMAP
+  if(s->mMap != NULL) {
+    munmap(s->mMap, s->mMapSize);
   }
+#endif
+  s->mMap = NULL;
+  s->mPos = NULL;
+  s->mEnd = NULL;
   return 1;
 }
 
@@ -126,13 +339,19 @@ blfSizedStreamUpdateBytesLeft(SizedStream *s, const uint32_t offset)
   if(offset > s->mBytesLeft) goto fail;
 
   s->mBytesLeft -= offset;
+  if((s->mBytesLeft == 0) && (s->mBytesAfter > 0)) {
+    /* unsized file: account the next portion */
+    s->mBytesLeft = (uint32_t)BLFMIN(s->mBytesAfter, UINT32_MAX);
+    if(s->mBytesAfter != UINT64_MAX) s->mBytesAfter -= s->mBytesLeft;
+  }
   if(s->mBytesLeft == 0) {
     if(s->mBuffer != NULL) {
-      free(s->mBuffer);
-      s->mBuffer = NULL;
+      blfSizedStreamReleaseBuffer(s);
+    }
+    if(s->mFile != NULL) {
+      fclose(s->mFile);
+      s->mFile = NULL;
     }
-    fclose(s->mFile);
-    s->mFile = NULL;
   }
   return 1;
 
@@ -143,9 +362,23 @@ fail:
 success_t
 blfSizedStreamDetermineBytesLeft(SizedStream *const s)
 {
+  if(s->mMap != NULL) {
+    /* files beyond 4GB are accounted in portions */
+    size_t left = (size_t)(s->mEnd - s->mPos);
+
+    s->mBytesLeft = (left > UINT32_MAX) ? UINT32_MAX : (uint32_t)left;
+    return s->mBytesLeft > 0;
+  }
+  if(s->mFile == NULL) return 0;
+  if(s->mUnsized) return s->mBytesLeft > 0;
   return blfFileGetRemainingFileSize(s->mFile, &s->mBytesLeft);
 }
 
+/*
+ * stream on a FILE. The size of files which can't seek, like pipes,
+ * is unknown; they are read up to EOF or the size set with
+ * blfSizedStreamSetSize().
+ */
 success_t
 blfSizedStreamInitFromFile(SizedStream *const s, FILE *const fp)
 {
@@ -154,13 +387,40 @@ blfSizedStreamInitFromFile(SizedStream *const s, FILE *const fp)
     goto fail;
   }
   s->mFile = fp;
-  if(!blfSizedStreamDetermineBytesLeft(s)) goto fail;
+  if(ftell(fp) == -1) {
+    s->mUnsized = 1;
+    blfSizedStreamSetSize(s, UINT64_MAX);
+  } else if(!blfSizedStreamDetermineBytesLeft(s)) {
+    goto fail;
+  }
   return 1;
 
 fail:
   return 0;
 }
 
+/* limit an unsized file stream to size bytes from the read position */
+void
+blfSizedStreamSetSize(SizedStream *const s, uint64_t size)
+{
+  if(!s->mUnsized) return;
+  s->mBytesLeft = (uint32_t)BLFMIN(size, UINT32_MAX);
+  s->mBytesAfter = (size == UINT64_MAX) ? UINT64_MAX : size - s->mBytesLeft;
+}
+
+/* stream on a file mapping, the mapping is released on close */
+success_t
+blfSizedStreamInitFromMapping(SizedStream *const s, void *map,
+                              const size_t size)
+{
+  s->mFile = NULL;
+  s->mMap = (uint8_t *)map;
+  s->mMapSize = size;
+  s->mPos = s->mMap;
+  s->mEnd = s->mMap + size;
+  return blfSizedStreamDetermineBytesLeft(s);
+}
+
 /*******************************************************************
  * blfDualStream: management of two streams, one file stream and one
  * memory stream. Data is initially read from the file stream. When
@@ -220,3 +480,43 @@ blfDualStreamReadOrSkip(DualStream *ds, void *dest, size_t nBytes, int fileOnly)
 {
   return blfSizedStreamReadOrSkip(blfDualStreamGetSizedStream(ds, fileOnly), dest, nBytes);
 }
+
+/*
+ * drop the memory stream and continue the file stream at offset, the
+ * file stream ends at offset end
+ */
+success_t
+blfDualStreamSeek(DualStream *ds, uint64_t offset, uint64_t end)
+{
+  SizedStream *const fs = &ds->fileStream;
+  SizedStream *const ms = &ds->memStream;
+
+  if(ms->mBuffer != NULL) {
+    blfSizedStreamReleaseBuffer(ms);
+  }
+  ms->mBytesLeft = 0;
+  if(end < offset) goto fail;
+
+  if(fs->mMap != NULL) {
+    if(end > fs->mMapSize) goto fail;
+    fs->mPos = fs->mMap + offset;
+    fs->mEnd = fs->mMap + end;
+    blfSizedStreamDetermineBytesLeft(fs);
+  } else {
+    /* the file is closed when the stream is drained */
+    if(fs->mFile == NULL)                                 goto fail;
+    if(end - offset > UINT32_MAX)                         goto fail;
+#ifdef HAVE_FSEEKO
+    if((off_t)offset < 0)                                 goto fail;
+    if(0 != fseeko(fs->mFile, (off_t)offset, SEEK_SET))   goto fail;
+#else
+    if(offset > LONG_MAX)                                 goto fail;
+    if(0 != fseek(fs->mFile, (long)offset, SEEK_SET))     goto fail;
+#endif
+    fs->mBytesLeft = (uint32_t)(end - offset);
+  }
+  return 1;
+
+fail:
+  return 0;
+}
@@ -37,14 +37,37 @@ typedef int success_t;
 #define BLFMIN(x,y) ((x)<(y)?(x):(y))
 
 /*
- * SizedStream: a file or memory based stream, which is tracking its
- * remaining bytes
+ * BufferPool: reusable buffers for container data. Buffers keep their
+ * capacity, which grows to the largest request seen, so that reading
+ * containers of similar size allocates no memory. The pool may be
+ * shared between threads.
+ */
+typedef struct blfBufferPool_s blfBufferPool_t;
+
+blfBufferPool_t *blfBufferPoolCreate(unsigned int maxFree);
+uint8_t *blfBufferPoolGet(blfBufferPool_t *pool, size_t size);
+void blfBufferPoolPut(blfBufferPool_t *pool, uint8_t *buffer);
+void blfBufferPoolFree(blfBufferPool_t *pool);
+
+/*
+ * SizedStream: a file, mapping or memory based stream, which is
+ * tracking its remaining bytes. Mapping and memory-based streams are
+ * cursors on their memory.
  */
 typedef struct{
-  FILE      *mFile;      /* FILE pointer to associated stream */
-  uint32_t   mBytesLeft; /* number of bytes left in stream */
-  uint8_t   *mBuffer;    /* pointer to allocated memory for a
-                            memory-based stream */
+  FILE          *mFile;      /* FILE pointer to associated stream */
+  uint32_t       mBytesLeft; /* number of bytes left in stream */
+  uint8_t       *mBuffer;    /* pointer to allocated memory for a
+                                memory-based stream */
+  const uint8_t *mPos;       /* read position of a memory-based stream */
+  const uint8_t *mEnd;       /* end of memory */
+  blfBufferPool_t *mPool;    /* owner of mBuffer, NULL if malloc()ed */
+  int            mBorrowed;  /* mBuffer is not owned by the stream */
+  uint8_t       *mMap;       /* file mapping, NULL if none */
+  size_t         mMapSize;
+  int            mUnsized;   /* file of unknown size, e.g. a pipe */
+  uint64_t       mBytesAfter;/* bytes of an unsized file following
+                                mBytesLeft, UINT64_MAX: up to EOF */
 } SizedStream;
 
 /*
@@ -59,12 +82,19 @@ typedef struct {
 
 success_t blfSizedStreamInitFromMem(SizedStream *const m, void *buffer,
                                     const size_t size);
-int blfSizedStreamIsEmpty(const SizedStream *const s);
+success_t blfSizedStreamInitFromView(SizedStream *const m,
+                                     const void *data, const size_t size);
 int blfSizedStreamIsEmpty(const SizedStream *const s);
 int blfSizedStreamIsOpen(const SizedStream *const s);
+const uint8_t *blfSizedStreamPeek(const SizedStream *const s,
+                                  size_t nBehind, size_t nAhead);
 FILE *blfFileStreamGetFile(SizedStream *fs);
 success_t blfSizedStreamDetermineBytesLeft(SizedStream *fs);
 success_t blfSizedStreamInitFromFile(SizedStream *const s, FILE *const fp);
+void blfSizedStreamSetSize(SizedStream *const s, uint64_t size);
+success_t blfFileSkip(FILE *fp, size_t nBytes);
+success_t blfSizedStreamInitFromMapping(SizedStream *const s, void *map,
+                                        const size_t size);
 
 void blfDualStreamInit (DualStream *ds);
 success_t blfDualStreamClose(DualStream *ds);
@@ -74,6 +104,7 @@ success_t blfDualStreamReadOrSkip(DualStream *ds, void *dest, size_t nBytes,
                                   int fileOnly);
 success_t blfDualStreamReduceBytesLeft(DualStream *ds,
                                        const uint32_t offset);
+success_t blfDualStreamSeek(DualStream *ds, uint64_t offset, uint64_t end);
 
 #ifdef __cplusplus
 }
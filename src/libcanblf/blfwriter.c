@@ -0,0 +1,290 @@
+/*  blfwriter.c -- write BLF files
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "blfwriter.h"
+#include "blfparser.h"
+
+struct blfWriter_s {
+  FILE     *fp;
+  int       level;          /* zlib level, 0: store uncompressed */
+  z_stream  stream;         /* deflate state, reused for all containers */
+  uint8_t  *container;      /* payload of current container */
+  uint32_t  containerSize;
+  uint32_t  nContainer;     /* bytes in current container */
+  uint8_t  *compressed;     /* deflated payload of current container */
+  uint32_t  compressedSize; /* size of compressed buffer */
+  LOGG_t    logg;           /* file header, completed on close */
+  success_t success;        /* no write error so far */
+};
+
+/* write LOG container with the collected payload */
+static success_t
+blfWriterFlushContainer(blfWriter_t *w)
+{
+  static const uint8_t padding[4] = { 0, 0, 0, 0 };
+  VBLObjectHeaderBaseLOGG header;
+  const uint8_t *payload = w->container;
+  uint32_t nPayload = w->nContainer;
+  uint32_t nPadding;
+
+  if(w->nContainer == 0) return 1;
+
+  memset(&header, 0, sizeof(header));
+  header.base.mSignature     = BL_OBJ_SIGNATURE;
+  header.base.mHeaderSize    = sizeof(header.base);
+  header.base.mHeaderVersion = 1;
+  header.base.mObjectType    = BL_OBJ_TYPE_LOG_CONTAINER;
+  header.deflatebuffersize   = w->nContainer;
+
+  if(w->level > 0) {
+    if(Z_OK != deflateReset(&w->stream))                     goto fail;
+    w->stream.next_in   = w->container;
+    w->stream.avail_in  = w->nContainer;
+    w->stream.next_out  = w->compressed;
+    w->stream.avail_out = w->compressedSize;
+    if(Z_STREAM_END != deflate(&w->stream, Z_FINISH))        goto fail;
+    payload = w->compressed;
+    nPayload = (uint32_t)w->stream.total_out;
+    header.compressedflag = 2;
+  }
+  header.base.mObjectSize = sizeof(header) + nPayload;
+  nPadding = header.base.mObjectSize & 3;
+
+  if(   (1 != fwrite(&header, sizeof(header), 1, w->fp))
+     || (1 != fwrite(payload, nPayload, 1, w->fp))
+     || (   (nPadding > 0)
+         && (1 != fwrite(padding, nPadding, 1, w->fp))))     goto fail;
+
+  w->logg.fileSize += header.base.mObjectSize + nPadding;
+  w->logg.uncompressedFileSize += sizeof(header) + w->nContainer;
+  w->nContainer = 0;
+  return 1;
+
+fail:
+  fprintf(stderr, "blfWriterFlushContainer(): can't write container\n");
+  w->success = 0;
+  return 0;
+}
+
+/* append bytes to container payload, objects may span two containers */
+static success_t
+blfWriterAppend(blfWriter_t *w, const void *data, uint32_t nBytes)
+{
+  const uint8_t *src = (const uint8_t *)data;
+
+  while(nBytes > 0) {
+    const uint32_t n = BLFMIN(nBytes, w->containerSize - w->nContainer);
+
+    memcpy(w->container + w->nContainer, src, n);
+    w->nContainer += n;
+    src += n;
+    nBytes -= n;
+    if(   (w->nContainer == w->containerSize)
+       && !blfWriterFlushContainer(w)) return 0;
+  }
+  return 1;
+}
+
+/* append object of objectSize bytes and its padding */
+static success_t
+blfWriterAppendObject(blfWriter_t *w, const void *object,
+                      uint32_t objectSize)
+{
+  static const uint8_t padding[4] = { 0, 0, 0, 0 };
+
+  w->logg.objectCount++;
+  return    blfWriterAppend(w, object, objectSize)
+         && blfWriterAppend(w, padding, objectSize & 3);
+}
+
+/* fill object header, the time stamp is given in nanoseconds */
+static void
+blfWriterInitHeader(VBLObjectHeader *header, uint32_t objectType,
+                    uint32_t objectSize, uint64_t timeStamp)
+{
+  header->mBase.mSignature     = BL_OBJ_SIGNATURE;
+  header->mBase.mHeaderSize    = sizeof(*header);
+  header->mBase.mHeaderVersion = 1;
+  header->mBase.mObjectSize    = objectSize;
+  header->mBase.mObjectType    = objectType;
+  header->mObjectFlags         = BL_OBJ_FLAG_TIME_ONE_NANS;
+  header->mReserved            = 0;
+  header->mObjectVersion       = 0;
+  header->mObjectTimeStamp     = timeStamp;
+}
+
+/*
+ * create BLF file
+ *
+ * path           output file name
+ * level          zlib compression level 0..9, 0 stores uncompressed
+ * containerSize  uncompressed payload size of LOG containers
+ *
+ * returns NULL on error
+ */
+blfWriter_t *
+blfWriterCreate(const char *path, int level, uint32_t containerSize)
+{
+  blfWriter_t *w = NULL;
+
+  if((level < 0) || (level > 9)) {
+    fprintf(stderr, "blfWriterCreate(): compression level must be 0..9\n");
+    goto fail;
+  }
+  if(containerSize == 0) {
+    fprintf(stderr, "blfWriterCreate(): container size must not be 0\n");
+    goto fail;
+  }
+
+  w = (blfWriter_t *)calloc(1, sizeof(*w));
+  if(w == NULL) goto fail_alloc;
+  w->level = level;
+  w->containerSize = containerSize;
+  w->success = 1;
+  w->container = (uint8_t *)malloc(containerSize);
+  if(w->container == NULL) goto fail_alloc;
+
+  if(level > 0) {
+    w->stream.zalloc = NULL;
+    w->stream.zfree = NULL;
+    w->stream.opaque = NULL;
+    if(Z_OK != deflateInit(&w->stream, level)) goto fail_alloc;
+    w->compressedSize = (uint32_t)deflateBound(&w->stream, containerSize);
+    w->compressed = (uint8_t *)malloc(w->compressedSize);
+    if(w->compressed == NULL) {
+      deflateEnd(&w->stream);
+      goto fail_alloc;
+    }
+  }
+
+  /* file header, completed on close */
+  w->logg.mSignature    = BL_LOGG_SIGNATURE;
+  w->logg.mHeaderSize   = sizeof(w->logg);
+  w->logg.dwCompression = (uint8_t)level;
+  w->logg.fileSize      = sizeof(w->logg);
+  w->logg.uncompressedFileSize = sizeof(w->logg);
+
+  w->fp = fopen(path, "wb");
+  if(w->fp == NULL) {
+    fprintf(stderr, "blfWriterCreate(): can't create %s\n", path);
+    goto fail_stream;
+  }
+  if(1 != fwrite(&w->logg, sizeof(w->logg), 1, w->fp)) {
+    fprintf(stderr, "blfWriterCreate(): can't write %s\n", path);
+    fclose(w->fp);
+    goto fail_stream;
+  }
+  return w;
+
+fail_alloc:
+  fprintf(stderr, "blfWriterCreate(): out of memory\n");
+  goto fail_free;
+fail_stream:
+  if(level > 0) deflateEnd(&w->stream);
+fail_free:
+  if(w != NULL) {
+    free(w->compressed);
+    free(w->container);
+    free(w);
+  }
+fail:
+  return NULL;
+}
+
+/* append CAN or CAN FD message */
+success_t
+blfWriterWriteCANMessage(blfWriter_t *w, const canMessage_t *canMessage)
+{
+  const uint64_t t =   (uint64_t)canMessage->t.tv_sec * 1000000000u
+                     + canMessage->t.tv_nsec;
+
+  if(!w->success) return 0;
+
+  if(canMessage->flags & CANMESSAGE_FLAG_FD) {
+    VBLCANFDMessage64 message;
+    const uint32_t size = offsetof(VBLCANFDMessage64, mData)
+                        + canMessage->len;
+
+    memset(&message, 0, sizeof(message));
+    blfWriterInitHeader(&message.mHeader, BL_OBJ_TYPE_CAN_FD_MESSAGE_64,
+                        size, t);
+    message.mChannel = canMessage->bus;
+    message.mDLC = canMessage->dlc;
+    message.mValidDataBytes = canMessage->len;
+    message.mID = canMessage->id;
+    message.mFlags = BL_CANFD64_FLAG_EDL;
+    if(canMessage->flags & CANMESSAGE_FLAG_BRS) {
+      message.mFlags |= BL_CANFD64_FLAG_BRS;
+    }
+    if(canMessage->flags & CANMESSAGE_FLAG_ESI) {
+      message.mFlags |= BL_CANFD64_FLAG_ESI;
+    }
+    memcpy(message.mData, canMessage->byte_arr, canMessage->len);
+    return blfWriterAppendObject(w, &message, size);
+  } else {
+    VBLCANMessage message;
+
+    memset(&message, 0, sizeof(message));
+    blfWriterInitHeader(&message.mHeader, BL_OBJ_TYPE_CAN_MESSAGE,
+                        sizeof(message), t);
+    message.mChannel = canMessage->bus;
+    message.mDLC = canMessage->dlc;
+    message.mID = canMessage->id;
+    memcpy(message.mData, canMessage->byte_arr,
+           BLFMIN(canMessage->len, sizeof(message.mData)));
+    return blfWriterAppendObject(w, &message, sizeof(message));
+  }
+}
+
+/*
+ * write pending container and file header, close file and free writer
+ *
+ * returns 0 if any write failed
+ */
+success_t
+blfWriterClose(blfWriter_t *w)
+{
+  success_t success;
+
+  if(w == NULL) return 0;
+
+  if(w->success && blfWriterFlushContainer(w)) {
+    if(   (0 != fseek(w->fp, 0, SEEK_SET))
+       || (1 != fwrite(&w->logg, sizeof(w->logg), 1, w->fp))) {
+      fprintf(stderr, "blfWriterClose(): can't write file header\n");
+      w->success = 0;
+    }
+  }
+  if(0 != fclose(w->fp)) {
+    fprintf(stderr, "blfWriterClose(): can't close file\n");
+    w->success = 0;
+  }
+  success = w->success;
+
+  if(w->level > 0) deflateEnd(&w->stream);
+  free(w->compressed);
+  free(w->container);
+  free(w);
+  return success;
+}
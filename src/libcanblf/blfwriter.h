@@ -0,0 +1,62 @@
+#ifndef INCLUDE_BLFWRITER_H
+#define INCLUDE_BLFWRITER_H
+
+/*  blfwriter.h -- declarations for blfWriter
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+#ifdef HAVE_INTTYPES_H
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+#include "blfapi.h"
+#include "measurement.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* zlib compression level of LOG containers, 0 stores them uncompressed */
+#define BLF_WRITER_DEFAULT_LEVEL 6
+
+/* uncompressed payload size of LOG containers */
+#define BLF_WRITER_DEFAULT_CONTAINER_SIZE (128u * 1024u)
+
+/*
+ * BLF file writer
+ *
+ * Messages are written as CAN_MESSAGE objects, CAN FD frames as
+ * CAN_FD_MESSAGE_64 objects, with time stamps in nanoseconds. Objects
+ * are packed into LOG containers of a fixed payload size and may span
+ * two containers. The LOGG header is completed on close.
+ */
+typedef struct blfWriter_s blfWriter_t;
+
+blfWriter_t *blfWriterCreate(const char *path, int level,
+                             uint32_t containerSize);
+success_t blfWriterWriteCANMessage(blfWriter_t *w,
+                                   const canMessage_t *canMessage);
+success_t blfWriterClose(blfWriter_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
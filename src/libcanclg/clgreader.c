@@ -14,6 +14,7 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>. */
 
+
 #include "cantools_config.h"
 
 #ifdef HAVE_INTTYPES_H
@@ -27,113 +28,340 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define CLGREADER_SSE2 1
+#endif
+
 #include "clgreader.h"
+#include "filemap.h"
 
-/*
- * Parser for CLG files.
- *
- * fp       FILE pointer of input file
- * msgRxCb  callback function for received messages
- * cbData   pointer to opaque callback data
- */
-void clgReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
-{
-  uint8_t busmap[256];
-  size_t ret;
-  clg_header_t header;
-  clg_message_t msg;
-  uint32_t channelshift, id_mask;
+/* records read per chunk from streams */
+#define CLGREADER_CHUNK_RECORDS 4096
 
-  /* initialize */
-  memset(busmap,0,sizeof(busmap));
+/* records unpacked per block */
+#define CLGREADER_BLOCK 4
 
-  /* get header */
-  ret = fread(&header, sizeof(header), 1, fp);
-  if(ret != 1) goto read_error;
+/* parser state */
+typedef struct {
+  uint8_t  busmap[256];
+  uint32_t channelshift;  /* bit position of channel in id_channel */
+  uint32_t id_mask;
+} clgParser_t;
 
+/* check header and determine bus type, returns 0 on success */
+static int clgReader_checkHeader(clgParser_t *parser,
+                                 const clg_header_t *header)
+{
   /* diagnose header */
-  if(0 != memcmp(header.identifier, "clg2", 4)) {
+  if(0 != memcmp(header->identifier, "clg2", 4)) {
     fprintf(stderr, "unexpected file identifier, not \"clg2\", aborting.\n");
-    return;
+    return -1;
   }
 
   /* bus type determination */
-  if(   ((header.channel_type1 == 255) && (header.channel_type2 == 7))
-     || ((header.channel_type1 == 0) && (header.channel_type2 == 0))) {
-    channelshift = 11; /* 11-bit CAN */
-  } else if((header.channel_type1 == 255) && (header.channel_type2 == 255)) {
-    channelshift = 29; /* 29-bit CAN */
+  if(   ((header->channel_type1 == 255) && (header->channel_type2 == 7))
+     || ((header->channel_type1 == 0) && (header->channel_type2 == 0))) {
+    parser->channelshift = 11; /* 11-bit CAN */
+  } else if((header->channel_type1 == 255)
+            && (header->channel_type2 == 255)) {
+    parser->channelshift = 29; /* 29-bit CAN */
   } else {
     fprintf(stderr, "unexpected bus type (%d, %d), aborting.\n",
-            header.channel_type1, header.channel_type2 );
-    return;
+            header->channel_type1, header->channel_type2 );
+    return -1;
   }
+  parser->id_mask = (1u << parser->channelshift)-1;
+  return 0;
+}
+
+/*
+ * gather little-endian log_time and id_channel words of a block of
+ * records, the SSE2 variant transposes the first 8 bytes of four
+ * records with two unpack stages
+ */
+static inline void clgReader_gatherBlock(const clg_message_t *msg,
+                                         uint32_t *log_time,
+                                         uint32_t *id_channel)
+{
+#ifdef CLGREADER_SSE2
+  const __m128i r0 = _mm_loadu_si128((const __m128i *)&msg[0]);
+  const __m128i r1 = _mm_loadu_si128((const __m128i *)&msg[1]);
+  const __m128i r2 = _mm_loadu_si128((const __m128i *)&msg[2]);
+  const __m128i r3 = _mm_loadu_si128((const __m128i *)&msg[3]);
+  const __m128i t01 = _mm_unpacklo_epi32(r0, r1); /* t0 t1 i0 i1 */
+  const __m128i t23 = _mm_unpacklo_epi32(r2, r3); /* t2 t3 i2 i3 */
+
+  _mm_storeu_si128((__m128i *)log_time,   _mm_unpacklo_epi64(t01, t23));
+  _mm_storeu_si128((__m128i *)id_channel, _mm_unpackhi_epi64(t01, t23));
+#else
+  unsigned int i;
 
-  id_mask = (1u << channelshift)-1;
-
-  /* loop for reading input lines */
-  while(1) {
-    canMessage_t message;
-    uint8_t i;
-    double dTime;
-    uint32_t dTime32;
-    uint32_t message_id;
-    uint8_t channel;
-    uint32_t id_channel;
-    off_t off;
-
-    off = ftello(fp);
-    // printf("%lld\n", off);
-
-    ret = fread(&msg, sizeof(msg), 1, fp);
-    if(ret != 1) {
-      break;
+  for(i = 0; i < CLGREADER_BLOCK; i++) {
+    log_time[i] =   ((uint32_t)msg[i].log_time_array[3] << 24)
+                  | ((uint32_t)msg[i].log_time_array[2] << 16)
+                  | ((uint32_t)msg[i].log_time_array[1] << 8)
+                  |  (uint32_t)msg[i].log_time_array[0];
+    id_channel[i] =   ((uint32_t)msg[i].id_channel_array[3] << 24)
+                    | ((uint32_t)msg[i].id_channel_array[2] << 16)
+                    | ((uint32_t)msg[i].id_channel_array[1] << 8)
+                    |  (uint32_t)msg[i].id_channel_array[0];
+  }
+#endif
+}
+
+/* append record to batch, the log time is given in milliseconds */
+static inline void clgReader_append(clgParser_t *parser,
+                                    const clg_message_t *msg,
+                                    uint32_t log_time, uint32_t id_channel,
+                                    msgBatch_t *batch)
+{
+  canMessage_t *message = msgBatch_next(batch);
+
+  message->t.tv_sec  = log_time / 1000;
+  message->t.tv_nsec = (log_time % 1000) * 1000000;
+  message->bus = (id_channel >> parser->channelshift) & 3;
+  message->id  = id_channel & parser->id_mask;
+  message->dlc = 8;
+  message->len = 8;
+  message->flags = 0;
+  memcpy(message->byte_arr, msg->data_array, 8);
+
+  parser->busmap[message->bus] = 1;
+
+  /* append message to batch */
+  msgBatch_commit(batch);
+}
+
+/*
+ * parse up to n records, as many as fit into the batch; blocks of
+ * records are unpacked together
+ *
+ * returns the number of parsed records
+ */
+static size_t clgReader_parseRecords(clgParser_t *parser,
+                                     const clg_message_t *msg, size_t n,
+                                     msgBatch_t *batch)
+{
+  uint32_t log_time[CLGREADER_BLOCK];
+  uint32_t id_channel[CLGREADER_BLOCK];
+  size_t i;
+  unsigned int k;
+
+  /* records fitting into the batch */
+  if(n > batch->size - batch->n) n = batch->size - batch->n;
+
+  for(i = 0; i + CLGREADER_BLOCK <= n; i += CLGREADER_BLOCK) {
+    clgReader_gatherBlock(&msg[i], log_time, id_channel);
+    for(k = 0; k < CLGREADER_BLOCK; k++) {
+      clgReader_append(parser, &msg[i + k], log_time[k], id_channel[k],
+                       batch);
     }
-    
-    id_channel =  (msg.id_channel_array[3] << 24)
-          | (msg.id_channel_array[2] << 16)
-          | (msg.id_channel_array[1] << 8)
-          |  msg.id_channel_array[0];
-
-    message_id = id_channel & id_mask;
-    channel    = (id_channel >> channelshift) & 3;
-
-    // printf("%1d %08x\t",channel, message_id);
-
-    /*
-     * timestamp
-     */
-    dTime32 = (msg.log_time_array[3] << 24)
-          | (msg.log_time_array[2] << 16)
-          | (msg.log_time_array[1] << 8)
-          |  msg.log_time_array[0];
-    dTime = dTime32 * 0.001;
-    // printf("%11.3lf\t",dTime);
-
-    message.t.tv_sec  = dTime;
-    message.t.tv_nsec = (dTime-message.t.tv_sec)*1e9;
-    message.bus = channel;
-    message.dlc = 8;
-    
-    /* get message bytes */
-    for(i = 0; i < message.dlc; i++) {
-      message.byte_arr[i] = msg.data_array[i];
-      // printf("%02x ",message.byte_arr[i]);
+  }
+
+  /* remaining records */
+  for(; i < n; i++) {
+    const uint8_t *t = msg[i].log_time_array;
+    const uint8_t *c = msg[i].id_channel_array;
+
+    clgReader_append(parser, &msg[i],
+                     ((uint32_t)t[3] << 24) | ((uint32_t)t[2] << 16)
+                     | ((uint32_t)t[1] << 8) | (uint32_t)t[0],
+                     ((uint32_t)c[3] << 24) | ((uint32_t)c[2] << 16)
+                     | ((uint32_t)c[1] << 8) | (uint32_t)c[0],
+                     batch);
+  }
+  return n;
+}
+
+/* reader state */
+struct clgReader_s {
+  FILE                *fp;
+  clgParser_t          parser;
+  void                *map;      /* memory mapping, NULL for streams */
+  size_t               mapSize;
+  clg_message_t       *chunk;    /* chunk buffer of streams */
+  const clg_message_t *record;   /* records of mapping or chunk */
+  size_t               nRecords;
+  size_t               pos;      /* next record to be parsed */
+  int                  eof;      /* no more records */
+};
+
+#ifdef HAVE_MMAP
+/*
+ * map regular file and check its header
+ *
+ * returns 0 on success, 1 on a header error, -1 if the file can't be
+ * mapped
+ */
+static int clgReader_openMapped(clgReader_t *r)
+{
+  clg_header_t header;
+  size_t size;
+  void *map;
+
+  map = fileMap_open(fileno(r->fp), &size);
+  if(map == NULL) return -1;
+  r->map = map;
+  r->mapSize = size;
+
+  if(size < sizeof(header)) {
+    fprintf(stderr,"error reading CLG file, aborting\n");
+    return 1;
+  }
+  memcpy(&header, map, sizeof(header));
+  if(clgReader_checkHeader(&r->parser, &header) != 0) return 1;
+
+  /* a truncated last record is ignored */
+  r->record = (const clg_message_t *)((const uint8_t *)map + sizeof(header));
+  r->nRecords = (size - sizeof(header)) / sizeof(clg_message_t);
+  r->eof = 1;
+  return 0;
+}
+#endif
+
+/*
+ * open stream, e.g. a pipe, read in chunks of records
+ *
+ * returns 0 on success, 1 on a header error
+ */
+static int clgReader_openStream(clgReader_t *r)
+{
+  clg_header_t header;
+
+  /* get header */
+  if(1 != fread(&header, sizeof(header), 1, r->fp)) {
+    fprintf(stderr,"error reading CLG file, aborting\n");
+    return 1;
+  }
+  if(clgReader_checkHeader(&r->parser, &header) != 0) return 1;
+
+  r->chunk = malloc(CLGREADER_CHUNK_RECORDS * sizeof(*r->chunk));
+  if(r->chunk == NULL) {
+    fprintf(stderr, "clgReader_open(): out of memory\n");
+    return 1;
+  }
+  r->record = r->chunk;
+  return 0;
+}
+
+/*
+ * open CLG file for reading batches of messages
+ *
+ * Regular files are parsed in place from a read-only memory mapping,
+ * other input, e.g. from a pipe, is read in chunks of records.
+ *
+ * fp       FILE pointer of input file, closed by clgReader_close() or
+ *          on error
+ *
+ * returns NULL on error
+ */
+clgReader_t *clgReader_open(FILE *fp)
+{
+  clgReader_t *r = calloc(1, sizeof(*r));
+  int ret = -1;
+
+  if(r == NULL) {
+    fprintf(stderr, "clgReader_open(): out of memory\n");
+    fclose(fp);
+    return NULL;
+  }
+  r->fp = fp;
+
+#ifdef HAVE_MMAP
+  ret = clgReader_openMapped(r);
+#endif
+  if(ret < 0) ret = clgReader_openStream(r);
+  if(ret != 0) {
+    clgReader_close(r);
+    return NULL;
+  }
+  return r;
+}
+
+/*
+ * parse next messages
+ *
+ * message  caller-provided array of size entries
+ *
+ * returns the number of messages, 0 at end of file
+ */
+unsigned int clgReader_nextBatch(clgReader_t *r, canMessage_t *message,
+                                 unsigned int size)
+{
+  msgBatch_t batch;
+
+  msgBatch_init(&batch, message, size, NULL, NULL);
+  while(!msgBatch_full(&batch)) {
+    if(r->pos == r->nRecords) {
+      if(r->eof) break;
+      r->nRecords = fread(r->chunk, sizeof(*r->chunk),
+                          CLGREADER_CHUNK_RECORDS, r->fp);
+      r->pos = 0;
+      if(r->nRecords < CLGREADER_CHUNK_RECORDS) r->eof = 1;
     }
-    message.id = message_id;
-    // puts("");
+    r->pos += clgReader_parseRecords(&r->parser, r->record + r->pos,
+                                     r->nRecords - r->pos, &batch);
+  }
+  return batch.n;
+}
 
-    busmap[message.bus] = 1;
+/* close input file and free reader */
+void clgReader_close(clgReader_t *r)
+{
+#ifdef HAVE_MMAP
+  if(r->map != NULL) munmap(r->map, r->mapSize);
+#endif
+  free(r->chunk);
+  fclose(r->fp);
+  free(r);
+}
 
-    /* invoke message receive callback function */
-    msgRxCb(&message, cbData);
-  } /* end message loop */
-  goto done;
+/*
+ * check for the CLG file identifier
+ *
+ * head     first n bytes of the file
+ *
+ * returns 1 for CLG files, 0 otherwise
+ */
+int clgReader_probe(const void *head, size_t n)
+{
+  return (n >= 4) && !memcmp(head, "clg2", 4);
+}
 
-read_error:
-  fprintf(stderr,"error reading CLG file, aborting\n");
+/*
+ * Parser for CLG files.
+ *
+ * fp       FILE pointer of input file
+ * batch    batch of received messages, flushed at end of file
+ */
+void clgReader_processFileBatch(FILE *fp, msgBatch_t *batch)
+{
+  clgReader_t *r = clgReader_open(fp);
+
+  if(r != NULL) {
+    while((batch->n = clgReader_nextBatch(r, batch->message,
+                                          batch->size)) > 0) {
+      msgBatch_flush(batch);
+    }
+    clgReader_close(r);
+  }
+}
+
+/*
+ * Parser for CLG files, per-message interface.
+ *
+ * fp       FILE pointer of input file
+ * msgRxCb  callback function for received messages
+ * cbData   pointer to opaque callback data
+ */
+void clgReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+{
+  canMessage_t message[MSGBATCH_ADAPTER_SIZE];
+  msgRxAdapter_t adapter = { msgRxCb, cbData };
+  msgBatch_t batch;
 
-done:
-  /* close input file stream */
-  fclose(fp);
+  msgBatch_init(&batch, message, MSGBATCH_ADAPTER_SIZE,
+                msgRxAdapter_batchCb, &adapter);
+  clgReader_processFileBatch(fp, &batch);
 }
@@ -47,7 +47,17 @@ typedef struct {
   clg_message_t unknown3[16];
 } clg_header_t;
 
+/* pull-based reader */
+typedef struct clgReader_s clgReader_t;
+
+clgReader_t *clgReader_open(FILE *fp);
+unsigned int clgReader_nextBatch(clgReader_t *r, canMessage_t *message,
+                                 unsigned int size);
+void         clgReader_close(clgReader_t *r);
+
 /* clgRead function */
+int  clgReader_probe(const void *head, size_t n);
+void clgReader_processFileBatch(FILE *fp, msgBatch_t *batch);
 void clgReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData);
 
 #endif
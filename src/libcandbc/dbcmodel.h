@@ -196,7 +196,7 @@ typedef struct {
   string_t          name;
   mux_t             mux_type;
   uint32            mux_value;
-  uint8             bit_start;
+  uint16            bit_start;
   uint8             bit_len;
   uint8             endianess;
   uint8             signedness;
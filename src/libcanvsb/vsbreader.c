@@ -29,103 +29,359 @@
 #include <ctype.h>
 
 #include "vsbreader.h"
+#include "filemap.h"
+
+extern int verbose_flag;
+
+/* read size of the stream parser, holds records with extra data */
+#define VSBREADER_CHUNK_SIZE (4096 * sizeof(icsSpyMessage_t))
+
+/* extra data of a record beyond this size is considered corrupt */
+#define VSBREADER_MAX_EXTRA (64 * 1024)
 
 /*
- * Parser for VSB files.
+ * hardware time stamp units: TimeHardware counts 1.6 us, TimeHardware2
+ * counts its overflows, i.e. 65536 * 1.6 us = 0.1048576 s
+ */
+#define VSBREADER_TIMEHARDWARE_NS  1600ULL
+#define VSBREADER_TIMEHARDWARE2_NS 104857600ULL
+
+/* parser state */
+typedef struct {
+  uint8_t busmap[256];    /* busses seen */
+  int extraData;          /* records are followed by their extra data */
+  unsigned long nSkipped; /* unusable records */
+} vsbParser_t;
+
+/*
+ * diagnose file header
  *
- * fp       FILE pointer of input file
- * msgRxCb  callback function for received messages
- * cbData   pointer to opaque callback data
+ * returns 0 on success, -1 if the file is no VSB file
  */
-void vsbReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+static int vsbReader_checkHeader(vsbParser_t *parser,
+                                 const vsb_header_t *header)
+{
+  if(0 != memcmp(header->text_identifier, "icsbin", 6)) {
+    fprintf(stderr, "unexpected file identifier, not \"icsbin\", aborting\n");
+    return -1;
+  }
+
+  if(   (header->file_version != 0x0101)
+     && (header->file_version != 0x0102)
+     && (header->file_version != 0x0103)) {
+    fprintf(stderr, "unexpected file version %x, aborting\n",
+            header->file_version);
+  }
+  if(verbose_flag) {
+    fprintf(stderr, "file version %x\n", header->file_version);
+  }
+  parser->extraData = (header->file_version >= 0x0103);
+  return 0;
+}
+
+/* smallest CAN FD data length code for len bytes */
+static uint8 vsbReader_lenToDlc(uint8 len)
+{
+  uint8 dlc = (len > 8) ? 9 : len;
+
+  while((dlc < 15) && (canMessage_dlcToLen(dlc, 1) < len)) dlc++;
+  return dlc;
+}
+
+/*
+ * convert the complete records within size bytes at data
+ *
+ * The records need not be aligned, each one is copied to an aligned
+ * structure, which compiles to a few register moves. Payloads beyond
+ * 8 bytes are copied from the extra data following the record.
+ * Records without their payload are skipped and counted. Parsing
+ * stops when the batch is full.
+ *
+ * returns the number of bytes consumed
+ */
+static size_t vsbReader_parseRecords(vsbParser_t *parser, const uint8_t *data,
+                                     size_t size, msgBatch_t *batch)
+{
+  const uint8_t *p = data;
+  const uint8_t *const end = data + size;
+
+  while(   ((size_t)(end - p) >= sizeof(icsSpyMessage_t))
+        && !msgBatch_full(batch)) {
+    canMessage_t *message;
+    icsSpyMessage_t msg;
+    const uint8_t *payload;
+    uint32_t nExtra = 0;
+    uint64_t t;
+
+    memcpy(&msg, p, sizeof(msg));
+    if(parser->extraData && msg.ExtraDataPtrEnabled) {
+      nExtra = msg.ExtraDataPtr;
+      if(nExtra > VSBREADER_MAX_EXTRA) {
+        /* no usable length, resume behind the record */
+        parser->nSkipped++;
+        p += sizeof(msg);
+        continue;
+      }
+    }
+    if((size_t)(end - p) - sizeof(msg) < nExtra) break;
+    payload = (msg.NumberBytesData > 8) ? p + sizeof(msg) : msg.Data;
+    p += sizeof(msg) + nExtra;
+
+    /* long payloads require the extra data */
+    if(   (msg.NumberBytesData > CANMESSAGE_MAX_LEN)
+       || ((msg.NumberBytesData > 8) && (nExtra < msg.NumberBytesData))) {
+      parser->nSkipped++;
+      continue;
+    }
+
+    message = msgBatch_next(batch);
+
+    /* exact time stamp in nanoseconds */
+    t =   msg.TimeHardware2 * VSBREADER_TIMEHARDWARE2_NS
+        + msg.TimeHardware  * VSBREADER_TIMEHARDWARE_NS;
+    message->t.tv_sec  = (time_t)(t / 1000000000ULL);
+    message->t.tv_nsec = (uint32)(t % 1000000000ULL);
+    message->bus = msg.NetworkID;
+    message->len = msg.NumberBytesData;
+    message->dlc = msg.NumberBytesData;
+    message->flags = 0;
+
+    if(   (msg.Protocol == VSB_PROTOCOL_CANFD)
+       || (msg.NumberBytesData > 8)) {
+      uint32_t status3;
+
+      memcpy(&status3, msg.AckBytes, sizeof(status3));
+      message->dlc = vsbReader_lenToDlc(message->len);
+      message->flags = CANMESSAGE_FLAG_FD;
+      if(status3 & VSB_STATUS3_CANFD_BRS) message->flags |= CANMESSAGE_FLAG_BRS;
+      if(status3 & VSB_STATUS3_CANFD_ESI) message->flags |= CANMESSAGE_FLAG_ESI;
+    }
+    memcpy(message->byte_arr, payload, message->len);
+    message->id = (uint32)msg.ArbIDOrHeader;
+
+    parser->busmap[message->bus] = 1;
+
+    /* append message to batch */
+    msgBatch_commit(batch);
+  }
+  return (size_t)(p - data);
+}
+
+/* reader state */
+struct vsbReader_s {
+  FILE          *fp;
+  vsbParser_t    parser;
+  void          *map;     /* memory mapping, NULL for streams */
+  size_t         mapSize;
+  uint8_t       *chunk;   /* chunk buffer of streams */
+  const uint8_t *data;    /* records of mapping or chunk */
+  size_t         fill;    /* bytes at data */
+  size_t         pos;     /* offset of next record */
+  int            eof;     /* no more data to be read */
+  int            done;    /* end of records reached */
+};
+
+#ifdef HAVE_MMAP
+/*
+ * map regular file and check its header
+ *
+ * returns 0 on success, 1 on a header error, -1 if the file can't be
+ * mapped
+ */
+static int vsbReader_openMapped(vsbReader_t *r)
 {
-  uint8_t busmap[256];
-  char *cp;
-  size_t ret;
   vsb_header_t header;
-  icsSpyMessage_t msg;
+  size_t size;
+  void *map;
 
-  /* initialize */
-  memset(busmap,0,sizeof(busmap));
+  map = fileMap_open(fileno(r->fp), &size);
+  if(map == NULL) return -1;
+  r->map = map;
+  r->mapSize = size;
+
+  if(size < sizeof(header)) {
+    fprintf(stderr,"error reading vsb file, aborting\n");
+    return 1;
+  }
+  memcpy(&header, map, sizeof(header));
+  if(vsbReader_checkHeader(&r->parser, &header) != 0) return 1;
+
+  r->data = (const uint8_t *)map + sizeof(header);
+  r->fill = size - sizeof(header);
+  r->eof = 1;
+  return 0;
+}
+#endif
+
+/*
+ * open stream, e.g. a pipe, read in chunks
+ *
+ * returns 0 on success, 1 on a header error
+ */
+static int vsbReader_openStream(vsbReader_t *r)
+{
+  vsb_header_t header;
 
   /* get header */
-  ret = fread(&header, sizeof(header), 1, fp);
-  if(ret != 1) goto read_error;
+  if(1 != fread(&header, sizeof(header), 1, r->fp)) {
+    fprintf(stderr,"error reading vsb file, aborting\n");
+    return 1;
+  }
+  if(vsbReader_checkHeader(&r->parser, &header) != 0) return 1;
 
-  /* diagnose header */
-  if(0 != memcmp(header.text_identifier, "icsbin", 6)) {
-    fprintf(stderr, "unexpected file identifier, not \"icsbin\", aborting\n");
-    return;
+  r->chunk = malloc(VSBREADER_CHUNK_SIZE);
+  if(r->chunk == NULL) {
+    fprintf(stderr, "vsbReader_open(): out of memory\n");
+    return 1;
   }
+  r->data = r->chunk;
+  return 0;
+}
 
-  if(   (header.file_version != 0x0101)
-     && (header.file_version != 0x0102)
-     && (header.file_version != 0x0103)) {
-    fprintf(stderr, "unexpected file version %x, aborting\n",
-            header.file_version);
+/*
+ * open VSB file for reading batches of messages
+ *
+ * Regular files are parsed in place from a read-only memory mapping,
+ * other input, e.g. from a pipe, is read in chunks of records.
+ *
+ * fp       FILE pointer of input file, closed by vsbReader_close() or
+ *          on error
+ *
+ * returns NULL on error
+ */
+vsbReader_t *vsbReader_open(FILE *fp)
+{
+  vsbReader_t *r = calloc(1, sizeof(*r));
+  int ret = -1;
+
+  if(r == NULL) {
+    fprintf(stderr, "vsbReader_open(): out of memory\n");
+    fclose(fp);
+    return NULL;
   }
-  printf("file version %x\n",header.file_version);
-  
-  /* loop for reading input lines */
-  while(1) {
-    canMessage_t message;
-    uint8_t i;
-    double dTime;
-
-    ret = fread(&msg, sizeof(msg), 1, fp);
-    // printf("fread %d %d\n", ret, feof(fp));
-    if(ret != 1) {
+  r->fp = fp;
+
+#ifdef HAVE_MMAP
+  ret = vsbReader_openMapped(r);
+#endif
+  if(ret < 0) ret = vsbReader_openStream(r);
+  if(ret != 0) {
+    vsbReader_close(r);
+    return NULL;
+  }
+  return r;
+}
+
+/*
+ * parse next messages
+ *
+ * A record is moved to the front of the chunk buffer if its extra
+ * data continues in the next chunk.
+ *
+ * message  caller-provided array of size entries
+ *
+ * returns the number of messages, 0 at end of file
+ */
+unsigned int vsbReader_nextBatch(vsbReader_t *r, canMessage_t *message,
+                                 unsigned int size)
+{
+  msgBatch_t batch;
+
+  msgBatch_init(&batch, message, size, NULL, NULL);
+  while(!r->done) {
+    size_t n;
+
+    r->pos += vsbReader_parseRecords(&r->parser, r->data + r->pos,
+                                     r->fill - r->pos, &batch);
+    if(msgBatch_full(&batch)) break;
+
+    if(r->eof) {
+      /* a truncated last record is ignored */
+      if(r->fill - r->pos >= sizeof(icsSpyMessage_t)) r->parser.nSkipped++;
+      r->done = 1;
       break;
     }
-    
-    if(msg.NumberBytesData > 8) {
-      fprintf(stderr, "error: DLC > 8\n");
-      goto read_error;
-    }
+    r->fill -= r->pos;
+    memmove(r->chunk, r->chunk + r->pos, r->fill);
+    r->pos = 0;
+    n = fread(r->chunk + r->fill, 1, VSBREADER_CHUNK_SIZE - r->fill, r->fp);
+    r->fill += n;
+    if(n == 0) r->eof = 1;
+  }
+  return batch.n;
+}
+
+/* close input file and free reader */
+void vsbReader_close(vsbReader_t *r)
+{
+  unsigned int i;
 
-    /*
-     * timestamps: the fractional part has 1-9 decimal places,
-     * depending on the setting of the recording SW.
-     */
-    const float NEOVI_TIMEHARDWARE2_SCALING = 0.1048576;
-    const float NEOVI_TIMEHARDWARE_SCALING  = 1.6e-6;
-
-    dTime = NEOVI_TIMEHARDWARE2_SCALING * msg.TimeHardware2
-          + NEOVI_TIMEHARDWARE_SCALING  * msg.TimeHardware, 
-    message.t.tv_sec  = dTime;
-    message.t.tv_nsec = (dTime-message.t.tv_sec)*1e9;
-    message.bus = msg.NetworkID;
-    message.dlc = msg.NumberBytesData;
-    
-    /* get message bytes */
-    for(i = 0; i < message.dlc; i++) {
-      message.byte_arr[i] = msg.Data[i];
+  /* dump busmap */
+  if(verbose_flag) {
+    fputs("bus allocation: ", stderr);
+    for(i = 0; i < sizeof(r->parser.busmap); i++) {
+      if(r->parser.busmap[i]) fprintf(stderr, "%d  ", i);
     }
-    message.id = (uint32)msg.ArbIDOrHeader;
+    fputs("\n", stderr);
+  }
+  if(r->parser.nSkipped > 0) {
+    fprintf(stderr, "vsbReader: %lu unusable records skipped\n",
+            r->parser.nSkipped);
+  }
 
-    busmap[message.bus] = 1;
+#ifdef HAVE_MMAP
+  if(r->map != NULL) munmap(r->map, r->mapSize);
+#endif
+  free(r->chunk);
+  fclose(r->fp);
+  free(r);
+}
 
-    /* invoke message receive callback function */
-    msgRxCb(&message, cbData);
-  } /* end message loop */
+/*
+ * check for the VSB file identifier
+ *
+ * head     first n bytes of the file
+ *
+ * returns 1 for VSB files, 0 otherwise
+ */
+int vsbReader_probe(const void *head, size_t n)
+{
+  return (n >= 6) && !memcmp(head, "icsbin", 6);
+}
 
-  /* dump busmap */
-  {
-    uint8_t i;
-    
-    fputs("bus allocation: ",stdout);
-    do {
-      if(busmap[i]) printf("%d  ",i);
-      i++;
-    } while(i!=0);
-    puts("");
+/*
+ * Parser for VSB files.
+ *
+ * fp       FILE pointer of input file
+ * batch    batch of received messages, flushed at end of file
+ */
+void vsbReader_processFileBatch(FILE *fp, msgBatch_t *batch)
+{
+  vsbReader_t *r = vsbReader_open(fp);
+
+  if(r != NULL) {
+    while((batch->n = vsbReader_nextBatch(r, batch->message,
+                                          batch->size)) > 0) {
+      msgBatch_flush(batch);
+    }
+    vsbReader_close(r);
   }
-  goto done;
+}
 
-read_error:
-  fprintf(stderr,"error reading vsb file, aborting\n");
+/*
+ * Parser for VSB files, per-message interface.
+ *
+ * fp       FILE pointer of input file
+ * msgRxCb  callback function for received messages
+ * cbData   pointer to opaque callback data
+ */
+void vsbReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData)
+{
+  canMessage_t message[MSGBATCH_ADAPTER_SIZE];
+  msgRxAdapter_t adapter = { msgRxCb, cbData };
+  msgBatch_t batch;
 
-done:
-  /* close input file stream */
-  fclose(fp);
+  msgBatch_init(&batch, message, MSGBATCH_ADAPTER_SIZE,
+                msgRxAdapter_batchCb, &adapter);
+  vsbReader_processFileBatch(fp, &batch);
 }
@@ -66,11 +66,19 @@ typedef struct {
   int16_t  DescriptionID;
   int32_t  ArbIDOrHeader;
   uint8_t  Data[8]; 
-  uint8_t  AckBytes[8]; 
-  float    ExtraDataPtr;
+  uint8_t  AckBytes[8];     /* CAN FD: StatusBitField3, StatusBitField4 */
+  uint32_t ExtraDataPtr;    /* 0x103: number of bytes following record */
   uint8_t  MiscData;
 } icsSpyMessage_t;
 
+/* Protocol of CAN FD records */
+#define VSB_PROTOCOL_CANFD 30
+
+/* StatusBitField3 of CAN FD records */
+#define VSB_STATUS3_CANFD_ESI 0x01
+#define VSB_STATUS3_CANFD_FDF 0x08
+#define VSB_STATUS3_CANFD_BRS 0x10
+
 typedef struct
 {
   uint32_t SystemTimeStampID;
@@ -85,7 +93,17 @@ typedef struct
 extern "C" {
 #endif
 
+/* pull-based reader */
+typedef struct vsbReader_s vsbReader_t;
+
+vsbReader_t *vsbReader_open(FILE *fp);
+unsigned int vsbReader_nextBatch(vsbReader_t *r, canMessage_t *message,
+                                 unsigned int size);
+void         vsbReader_close(vsbReader_t *r);
+
 /* vsbRead function */
+int  vsbReader_probe(const void *head, size_t n);
+void vsbReader_processFileBatch(FILE *fp, msgBatch_t *batch);
 void vsbReader_processFile(FILE *fp, msgRxCb_t msgRxCb, void *cbData);
 
 #ifdef __cplusplus
@@ -0,0 +1,378 @@
+/*  check_canmessage_decode.c --  test CAN message signal extraction
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+/* Check unit test tool header */
+#include <check.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "messagedecoder.h"
+
+static uint64_t        decodedValue;
+static double          decodedPhysical;
+static int             decodedCount;
+static const signal_t *decodedSignal[8];
+
+static void signalProc_store(const signalLayout_t *sl,
+                             double                dtime,
+                             uint64_t              rawValue,
+                             double                physicalValue,
+                             void                 *cbData)
+{
+  decodedValue = rawValue;
+  decodedPhysical = physicalValue;
+  if(decodedCount < 8) decodedSignal[decodedCount] = sl->signal;
+  decodedCount++;
+}
+
+/* walk to the next lower bit of a signal */
+static int bit_next(int bit, int bigEndian)
+{
+  if(!bigEndian) return bit + 1;
+  return ((bit & 7) == 0) ? bit + 15 : bit - 1;
+}
+
+/* store value in payload bit by bit, starting with the LSB */
+static int payload_store(uint8 *payload, int bitStart, int bitLen,
+                         int bigEndian, uint64_t value)
+{
+  int bit = bitStart;
+  int i;
+
+  /* Motorola signals are numbered from their MSB */
+  if(bigEndian) {
+    for(i = 1; i < bitLen; i++) bit = bit_next(bit, 1);
+  }
+  for(i = 0; i < bitLen; i++) {
+    if((bit < 0) || (bit >= CANMESSAGE_MAX_LEN * 8)) return -1;
+    if((value >> i) & 1) payload[bit / 8] |= (uint8)(1 << (bit & 7));
+    if(bigEndian) {
+      /* walk back towards the MSB */
+      bit = ((bit & 7) == 7) ? bit - 15 : bit + 1;
+    } else {
+      bit = bit_next(bit, 0);
+    }
+  }
+  return 0;
+}
+
+/* payload length required by a signal */
+static int signal_lastByte(int bitStart, int bitLen, int bigEndian)
+{
+  int bit = bitStart;
+  int i;
+
+  for(i = 1; i < bitLen; i++) bit = bit_next(bit, bigEndian);
+  return bit / 8;
+}
+
+/*
+ * byte_order: Intel/Motorola
+ * bit_start: every bit position of a 64 byte CAN FD payload
+ * bit_len: 1..64
+ * signedness: U/S
+ * payload: single bit walking through the signal, all ones
+ */
+START_TEST(check_canmessage_decode)
+{
+  signal_t signal;
+  signal_list_t signalList;
+  message_t message;
+  canMessage_t canMessage;
+  int endianess, bitStart, bitLen, signedness, i;
+
+  memset(&signal, 0, sizeof(signal));
+  memset(&signalList, 0, sizeof(signalList));
+  memset(&message, 0, sizeof(message));
+  memset(&canMessage, 0, sizeof(canMessage));
+  signal.name = "s";
+  signal.scale = 1;
+  signalList.signal = &signal;
+  message.name = "m";
+  message.signal_list = &signalList;
+
+  for(endianess = 0; endianess <= 1; endianess++) {
+    for(bitStart = 0; bitStart < CANMESSAGE_MAX_LEN * 8; bitStart++) {
+      for(bitLen = 1; bitLen <= 64; bitLen++) {
+        for(signedness = 0; signedness <= 1; signedness++) {
+          messageLayout_t *layout;
+          int lastByte = signal_lastByte(bitStart, bitLen, !endianess);
+
+          /* signal leaves the payload, rejection is checked below */
+          if(lastByte >= CANMESSAGE_MAX_LEN) continue;
+
+          signal.endianess  = endianess;
+          signal.signedness = signedness;
+          signal.bit_start  = bitStart;
+          signal.bit_len    = bitLen;
+
+          layout = messageLayout_create(&message);
+          ck_assert(layout != NULL);
+          ck_assert(layout->nSignals == 1);
+
+          for(i = 0; i <= bitLen; i++) {
+            /* walking bit, finally all bits set */
+            uint64_t p = (i < bitLen) ? ((uint64_t)1 << i)
+                       : ((bitLen == 64) ? ~(uint64_t)0
+                                         : (((uint64_t)1 << bitLen) - 1));
+            uint64_t expected = p;
+
+            if(signedness && (bitLen < 64) && ((p >> (bitLen - 1)) & 1)) {
+              expected |= ~(uint64_t)0 << bitLen;
+            }
+
+            memset(canMessage.byte_arr, 0, sizeof(canMessage.byte_arr));
+            ck_assert(payload_store(canMessage.byte_arr, bitStart, bitLen,
+                                    !endianess, p) == 0);
+
+            canMessage.len = CANMESSAGE_MAX_LEN;
+            decodedCount = 0;
+            canMessage_decode(layout, &canMessage, 0,
+                              signalProc_store, NULL);
+            ck_assert(decodedCount == 1);
+            if(decodedValue != expected) {
+              printf("bo = %d, bit_start = %d, bit_len = %d, signed = %d, "
+                     "p = %llx, res = %llx\n",
+                     endianess, bitStart, bitLen, signedness,
+                     (unsigned long long)p,
+                     (unsigned long long)decodedValue);
+            }
+            ck_assert(decodedValue == expected);
+
+            /* signals beyond the received payload are skipped */
+            canMessage.len = lastByte;
+            decodedCount = 0;
+            canMessage_decode(layout, &canMessage, 0,
+                              signalProc_store, NULL);
+            ck_assert(decodedCount == 0);
+          }
+
+          /* the layout does not own the test message */
+          free(layout->signals);
+          free(layout);
+        }
+      }
+    }
+  }
+
+  /* a signal leaving the payload is not decoded at all */
+  {
+    messageLayout_t *layout;
+
+    signal.endianess  = 1;
+    signal.signedness = 0;
+    signal.bit_start  = CANMESSAGE_MAX_LEN * 8 - 1;
+    signal.bit_len    = 2;
+    layout = messageLayout_create(&message);
+    ck_assert(layout != NULL);
+    ck_assert(layout->nSignals == 0);
+    free(layout->signals);
+    free(layout);
+  }
+}
+END_TEST
+
+/*
+ * byte_order: Intel/Motorola
+ * bit_len: 33..64, signed, scale 0.5, offset 10
+ * payload: all ones, sign bit only, largest positive value
+ */
+START_TEST(check_canmessage_signed)
+{
+  signal_t signal;
+  signal_list_t signalList;
+  message_t message;
+  canMessage_t canMessage;
+  int endianess, bitLen, i;
+
+  memset(&signal, 0, sizeof(signal));
+  memset(&signalList, 0, sizeof(signalList));
+  memset(&message, 0, sizeof(message));
+  memset(&canMessage, 0, sizeof(canMessage));
+  signal.name = "s";
+  signal.scale = 0.5;
+  signal.offset = 10;
+  signal.signedness = 1;
+  signalList.signal = &signal;
+  message.name = "m";
+  message.signal_list = &signalList;
+
+  for(endianess = 0; endianess <= 1; endianess++) {
+    for(bitLen = 33; bitLen <= 64; bitLen++) {
+      const uint64_t signBit = (uint64_t)1 << (bitLen - 1);
+      const uint64_t p[3] = {
+        signBit | (signBit - 1), signBit, signBit - 1
+      };
+      const int64_t value[3] = {
+        -1, -(int64_t)(signBit - 1) - 1, (int64_t)(signBit - 1)
+      };
+      messageLayout_t *layout;
+
+      /* Motorola signals start at their MSB */
+      signal.endianess = endianess;
+      signal.bit_start = endianess ? 0 : 7;
+      signal.bit_len   = bitLen;
+
+      layout = messageLayout_create(&message);
+      ck_assert(layout != NULL);
+      ck_assert(layout->nSignals == 1);
+
+      for(i = 0; i < 3; i++) {
+        memset(canMessage.byte_arr, 0, sizeof(canMessage.byte_arr));
+        ck_assert(payload_store(canMessage.byte_arr, signal.bit_start,
+                                bitLen, !endianess, p[i]) == 0);
+        canMessage.len = 8;
+        decodedCount = 0;
+        canMessage_decode(layout, &canMessage, 0, signalProc_store, NULL);
+        ck_assert(decodedCount == 1);
+        ck_assert(decodedValue == (uint64_t)value[i]);
+        ck_assert(decodedPhysical == (double)value[i] * 0.5 + 10);
+      }
+
+      /* the layout does not own the test message */
+      free(layout->signals);
+      free(layout);
+    }
+  }
+}
+END_TEST
+
+/*
+ * multiplexor: 8 bit (dense jump table) and 32 bit (sparse values)
+ * signals: one plain signal, two signals per multiplexed group
+ */
+START_TEST(check_canmessage_mux)
+{
+  static const uint32 muxValues[2][3] = {
+    { 0, 1, 200 },
+    { 5, 100000, 3000000000u }
+  };
+  signal_t signal[8];
+  signal_list_t signalList[8];
+  message_t message;
+  canMessage_t canMessage;
+  int muxBits, i, k;
+
+  for(muxBits = 8; muxBits <= 32; muxBits += 24) {
+    const uint32 *values = muxValues[muxBits == 32];
+    messageLayout_t *layout;
+
+    memset(signal, 0, sizeof(signal));
+    memset(signalList, 0, sizeof(signalList));
+    memset(&message, 0, sizeof(message));
+    for(i = 0; i < 8; i++) {
+      signal[i].name = "s";
+      signal[i].scale = 1;
+      signal[i].endianess = 1;
+      signal[i].bit_len = 8;
+      signal[i].bit_start = 32 + 8 * (i & 1);
+      signalList[i].signal = &signal[i];
+      signalList[i].next = (i < 7) ? &signalList[i + 1] : NULL;
+    }
+    /* multiplexed signals of all groups, in reverse value order */
+    for(i = 0; i < 6; i++) {
+      signal[i].mux_type = m_multiplexed;
+      signal[i].mux_value = values[2 - i / 2];
+    }
+    signal[6].mux_type = m_multiplexor;
+    signal[6].bit_start = 0;
+    signal[6].bit_len = muxBits;
+    signal[7].bit_start = 48;
+    message.name = "m";
+    message.signal_list = &signalList[0];
+
+    layout = messageLayout_create(&message);
+    ck_assert(layout != NULL);
+    ck_assert(layout->nGroups == 3);
+    ck_assert((layout->muxTable != NULL) == (muxBits == 8));
+
+    for(k = 0; k < 4; k++) {
+      /* the last multiplexor value selects no group */
+      uint32 muxValue = (k < 3) ? values[k] : values[2] - 1;
+
+      memset(&canMessage, 0, sizeof(canMessage));
+      canMessage.len = 8;
+      for(i = 0; i < muxBits / 8; i++) {
+        canMessage.byte_arr[i] = (uint8)(muxValue >> (8 * i));
+      }
+      decodedCount = 0;
+      canMessage_decode(layout, &canMessage, 0, signalProc_store, NULL);
+      if(k == 3) {
+        ck_assert(decodedCount == 2);
+      } else {
+        /* group signals follow the plain signals, in DBC order */
+        ck_assert(decodedCount == 4);
+        ck_assert(decodedSignal[0] == &signal[6]);
+        ck_assert(decodedSignal[1] == &signal[7]);
+        ck_assert(decodedSignal[2] == &signal[4 - 2 * k]);
+        ck_assert(decodedSignal[3] == &signal[5 - 2 * k]);
+      }
+    }
+
+    /* the layout does not own the test message */
+    free(layout->muxTable);
+    free(layout->groups);
+    free(layout->signals);
+    free(layout);
+  }
+}
+END_TEST
+
+START_TEST(check_canmessage_dlc)
+{
+  ck_assert(canMessage_dlcToLen(8, 0) == 8);
+  ck_assert(canMessage_dlcToLen(15, 0) == 8);
+  ck_assert(canMessage_dlcToLen(8, 1) == 8);
+  ck_assert(canMessage_dlcToLen(9, 1) == 12);
+  ck_assert(canMessage_dlcToLen(13, 1) == 32);
+  ck_assert(canMessage_dlcToLen(15, 1) == 64);
+}
+END_TEST
+
+Suite * test_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("cantools");
+  tc_core = tcase_create("Core");
+  tcase_set_timeout(tc_core, 60);
+  tcase_add_test(tc_core, check_canmessage_decode);
+  tcase_add_test(tc_core, check_canmessage_signed);
+  tcase_add_test(tc_core, check_canmessage_mux);
+  tcase_add_test(tc_core, check_canmessage_dlc);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  s = test_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
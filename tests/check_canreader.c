@@ -0,0 +1,449 @@
+/*  check_canreader.c --  test pull-based trace file readers
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+/* Check unit test tool header */
+#include <check.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include "canreader.h"
+#include "blfwriter.h"
+#include "blfindex.h"
+#include "clgreader.h"
+#include "vsbreader.h"
+
+int verbose_flag = 0;
+int debug_flag   = 0;
+
+/* number of messages of the generated traces */
+#define TRACE_NMESSAGES 3000
+
+/* pseudo random numbers, reproducible across platforms */
+static unsigned int rand_next(unsigned int *state)
+{
+  *state = *state * 1103515245u + 12345u;
+  return (*state >> 16) & 0x7FFF;
+}
+
+/*
+ * message i of the generated traces: strictly increasing time stamps
+ * in milliseconds, which every format can represent exactly
+ *
+ * Classic frames carry 8 data bytes. With fd set, every other frame is
+ * a CAN FD frame, cycling through all data length codes.
+ */
+static void trace_message(unsigned int i, unsigned int *state, int fd,
+                          canMessage_t *message)
+{
+  unsigned int ms = 2 * i + ((i % 3) == 0);
+  unsigned int j;
+
+  memset(message, 0, sizeof(*message));
+  message->t.tv_sec  = ms / 1000;
+  message->t.tv_nsec = (ms % 1000) * 1000000;
+  message->bus = 1 + rand_next(state) % 2;
+  message->id  = 0x100 + rand_next(state) % 0x600;
+  if(fd && (i % 2)) {
+    message->dlc = (i / 2) % 16;
+    message->len = canMessage_dlcToLen(message->dlc, 1);
+    message->flags = CANMESSAGE_FLAG_FD;
+    if(i % 3) message->flags |= CANMESSAGE_FLAG_BRS;
+    if(i % 5 == 0) message->flags |= CANMESSAGE_FLAG_ESI;
+  } else {
+    message->dlc = 8;
+    message->len = 8;
+  }
+  for(j = 0; j < message->len; j++) {
+    message->byte_arr[j] = rand_next(state) & 0xFF;
+  }
+}
+
+static unsigned int message_ms(const canMessage_t *message)
+{
+  return message->t.tv_sec * 1000 + message->t.tv_nsec / 1000000;
+}
+
+static uint64_t message_time(const canMessage_t *message)
+{
+  return (uint64_t)message->t.tv_sec * 1000000000ULL
+         + message->t.tv_nsec;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+static void trace_writeAsc(const char *path)
+{
+  unsigned int state = 1;
+  canMessage_t message;
+  unsigned int i, j;
+  FILE *fp = fopen(path, "w");
+
+  ck_assert(fp != NULL);
+  fprintf(fp, "date Mon Jan 1 00:00:00 2018\n"
+              "base hex  timestamps absolute\n"
+              "Begin Triggerblock Mon Jan 1 00:00:00 2018\n");
+  for(i = 0; i < TRACE_NMESSAGES; i++) {
+    trace_message(i, &state, 0, &message);
+    fprintf(fp, "   %lu.%06u %u  %X  Rx   d 8",
+            (unsigned long)message.t.tv_sec, message.t.tv_nsec / 1000,
+            message.bus, message.id);
+    for(j = 0; j < 8; j++) fprintf(fp, " %02X", message.byte_arr[j]);
+    fprintf(fp, "\n");
+  }
+  fprintf(fp, "End TriggerBlock\n");
+  ck_assert(fclose(fp) == 0);
+}
+
+static void trace_writeBlf(const char *path)
+{
+  unsigned int state = 1;
+  canMessage_t message;
+  unsigned int i;
+  /* small containers for a useful index */
+  blfWriter_t *w = blfWriterCreate(path, 6, 1024);
+
+  ck_assert(w != NULL);
+  for(i = 0; i < TRACE_NMESSAGES; i++) {
+    trace_message(i, &state, 1, &message);
+    ck_assert(blfWriterWriteCANMessage(w, &message));
+  }
+  ck_assert(blfWriterClose(w));
+}
+
+static void trace_writeClg(const char *path)
+{
+  unsigned int state = 1;
+  canMessage_t message;
+  clg_header_t header;
+  clg_message_t record;
+  unsigned int i;
+  FILE *fp = fopen(path, "wb");
+
+  ck_assert(fp != NULL);
+  memset(&header, 0, sizeof(header));
+  memcpy(header.identifier, "clg2", 4);
+  header.channel_type1 = 255;
+  header.channel_type2 = 255;
+  ck_assert(fwrite(&header, sizeof(header), 1, fp) == 1);
+  for(i = 0; i < TRACE_NMESSAGES; i++) {
+    trace_message(i, &state, 0, &message);
+    put32(record.log_time_array, message_ms(&message));
+    put32(record.id_channel_array,
+          message.id | ((uint32_t)message.bus << 29));
+    memcpy(record.data_array, message.byte_arr, 8);
+    ck_assert(fwrite(&record, sizeof(record), 1, fp) == 1);
+  }
+  ck_assert(fclose(fp) == 0);
+}
+
+static void trace_writeVsb(const char *path)
+{
+  unsigned int state = 1;
+  canMessage_t message;
+  vsb_header_t header;
+  icsSpyMessage_t record;
+  uint8_t extra[CANMESSAGE_MAX_LEN + 2];
+  unsigned int i;
+  FILE *fp = fopen(path, "wb");
+
+  ck_assert(fp != NULL);
+  memset(&header, 0, sizeof(header));
+  memcpy(header.text_identifier, "icsbin", 6);
+  header.file_version = 0x0103;
+  ck_assert(fwrite(&header, sizeof(header), 1, fp) == 1);
+  for(i = 0; i < TRACE_NMESSAGES; i++) {
+    /* 1 ms are 625 hardware ticks of 1.6 us */
+    uint32_t ticks;
+
+    trace_message(i, &state, 1, &message);
+    ticks = message_ms(&message) * 625;
+    memset(&record, 0, sizeof(record));
+    record.TimeHardware  = ticks % 65536;
+    record.TimeHardware2 = ticks / 65536;
+    record.NetworkID = message.bus;
+    record.Protocol = 1;
+    record.NumberBytesData = message.len;
+    record.ArbIDOrHeader = message.id;
+    memcpy(record.Data, message.byte_arr,
+           (message.len > 8) ? 8 : message.len);
+    if(message.flags & CANMESSAGE_FLAG_FD) {
+      uint32_t status3 = VSB_STATUS3_CANFD_FDF;
+
+      if(message.flags & CANMESSAGE_FLAG_BRS) {
+        status3 |= VSB_STATUS3_CANFD_BRS;
+      }
+      if(message.flags & CANMESSAGE_FLAG_ESI) {
+        status3 |= VSB_STATUS3_CANFD_ESI;
+      }
+      put32(record.AckBytes, status3);
+      record.Protocol = VSB_PROTOCOL_CANFD;
+
+      /* payload as extra data, followed by two bytes to be skipped */
+      record.ExtraDataPtrEnabled = 1;
+      record.ExtraDataPtr = message.len + 2;
+      memcpy(extra, message.byte_arr, message.len);
+      extra[message.len] = 0xAA;
+      extra[message.len + 1] = 0xBB;
+    }
+    ck_assert(fwrite(&record, sizeof(record), 1, fp) == 1);
+    if(record.ExtraDataPtrEnabled) {
+      ck_assert(fwrite(extra, record.ExtraDataPtr, 1, fp) == 1);
+    }
+  }
+  ck_assert(fclose(fp) == 0);
+}
+
+/* messages of a complete parse */
+typedef struct {
+  canMessage_t *message;
+  unsigned int  n;
+} trace_t;
+
+static void trace_collect(canMessage_t *message, unsigned int n,
+                          void *cbData)
+{
+  trace_t *trace = (trace_t *)cbData;
+
+  trace->message = realloc(trace->message,
+                           (trace->n + n) * sizeof(*message));
+  ck_assert(trace->message != NULL);
+  memcpy(trace->message + trace->n, message, n * sizeof(*message));
+  trace->n += n;
+}
+
+static int message_equal(const canMessage_t *a, const canMessage_t *b)
+{
+  return    (a->t.tv_sec == b->t.tv_sec)
+         && (a->t.tv_nsec == b->t.tv_nsec)
+         && (a->bus == b->bus)
+         && (a->id == b->id)
+         && (a->dlc == b->dlc)
+         && (a->len == b->len)
+         && (a->flags == b->flags)
+         && !memcmp(a->byte_arr, b->byte_arr, a->len);
+}
+
+/*
+ * read remaining messages of r in batches of size, compare them with
+ * the reference starting at message first
+ */
+static void reader_compare(canReader_t *r, unsigned int size,
+                           const trace_t *reference, unsigned int first)
+{
+  canMessage_t message[7];
+  unsigned int i = first;
+  unsigned int n, j;
+
+  while((n = canReader_nextBatch(r, message, size)) > 0) {
+    ck_assert(n <= size);
+    for(j = 0; j < n; j++, i++) {
+      ck_assert(i < reference->n);
+      ck_assert(message_equal(&message[j], &reference->message[i]));
+    }
+  }
+  ck_assert(i == reference->n);
+}
+
+/*
+ * reader of a format against its processFile function: batch sizes,
+ * forward and backward seek, early close
+ */
+static void check_reader(const char *path, const char *formatName,
+                         int fd)
+{
+  static const unsigned int sizes[] = { 1, 7 };
+  static const unsigned int threads[] = { 1, 4 };
+  const canReaderFormat_t *format = canReader_format(formatName);
+  unsigned int t, s;
+
+  ck_assert(format != NULL);
+  ck_assert(canReader_detect(path) == format);
+
+  for(t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+    canMessage_t message[7], batchMessage[64];
+    trace_t reference = { NULL, 0 };
+    msgBatch_t batch;
+    canReader_t *r;
+    unsigned int n, consumed, state;
+    FILE *fp;
+
+    canReader_setThreads(threads[t]);
+
+    /* reference */
+    fp = fopen(path, "rb");
+    ck_assert(fp != NULL);
+    msgBatch_init(&batch, batchMessage, 64, trace_collect, &reference);
+    format->process(fp, &batch);
+    ck_assert(reference.n == TRACE_NMESSAGES);
+    for(n = 0, state = 1; n < TRACE_NMESSAGES; n++) {
+      canMessage_t generated;
+
+      trace_message(n, &state, fd, &generated);
+      ck_assert(message_equal(&reference.message[n], &generated));
+    }
+
+    /* complete reads */
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      r = canReader_open(path, NULL);
+      ck_assert(r != NULL);
+      reader_compare(r, sizes[s], &reference, 0);
+      canReader_close(r);
+    }
+
+    /* forward seek behind the first batch */
+    r = canReader_open(path, NULL);
+    ck_assert(r != NULL);
+    ck_assert(canReader_nextBatch(r, message, 7) == 7);
+    ck_assert(canReader_seekTime(r, message_time(
+                &reference.message[TRACE_NMESSAGES / 2])) == 0);
+    reader_compare(r, 7, &reference, TRACE_NMESSAGES / 2);
+    canReader_close(r);
+
+    /* backward seek, only seekable formats go back */
+    r = canReader_open(path, NULL);
+    ck_assert(r != NULL);
+    consumed = 0;
+    while(consumed <= TRACE_NMESSAGES / 2) {
+      n = canReader_nextBatch(r, message, 7);
+      ck_assert(n > 0);
+      consumed += n;
+    }
+    if(format->seekTime == NULL) {
+      ck_assert(canReader_seekTime(r, message_time(
+                  &reference.message[0])) == -1);
+      reader_compare(r, 7, &reference, consumed);
+    } else {
+      ck_assert(canReader_seekTime(r, message_time(
+                  &reference.message[1])) == 0);
+      reader_compare(r, 7, &reference, 1);
+    }
+    canReader_close(r);
+
+    /* early close */
+    r = canReader_open(path, NULL);
+    ck_assert(r != NULL);
+    ck_assert(canReader_nextBatch(r, message, 7) == 7);
+    canReader_close(r);
+
+    free(reference.message);
+  }
+  canReader_setThreads(1);
+}
+
+START_TEST(check_canreader_asc)
+{
+  const char *path = "check_canreader.asc";
+
+  trace_writeAsc(path);
+  check_reader(path, "ASC", 0);
+  remove(path);
+}
+END_TEST
+
+START_TEST(check_canreader_blf)
+{
+  const char *path = "check_canreader.blf";
+
+  trace_writeBlf(path);
+  check_reader(path, "BLF", 1);
+  remove(path);
+
+  /* seeking leaves no index sidecar behind */
+  ck_assert(fopen("check_canreader.blf" BLF_INDEX_SUFFIX, "rb") == NULL);
+}
+END_TEST
+
+START_TEST(check_canreader_clg)
+{
+  const char *path = "check_canreader.clg";
+
+  trace_writeClg(path);
+  check_reader(path, "CLG", 0);
+  remove(path);
+}
+END_TEST
+
+START_TEST(check_canreader_vsb)
+{
+  const char *path = "check_canreader.vsb";
+
+  trace_writeVsb(path);
+  check_reader(path, "VSB", 1);
+  remove(path);
+}
+END_TEST
+
+START_TEST(check_canreader_stdin)
+{
+  const char *path = "check_canreader.txt";
+  FILE *fp;
+
+  fp = fopen(path, "wb");
+  ck_assert(fp != NULL);
+  fputs("no trace file\n", fp);
+  fclose(fp);
+
+  /* a rejected stdin is left open */
+  ck_assert(freopen(path, "rb", stdin) != NULL);
+  ck_assert(canReader_open(NULL, NULL) == NULL);
+  ck_assert(fcntl(fileno(stdin), F_GETFD) != -1);
+  ck_assert(fgetc(stdin) == 'n');
+  remove(path);
+}
+END_TEST
+
+Suite * test_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("cantools");
+  tc_core = tcase_create("Core");
+  tcase_set_timeout(tc_core, 60);
+  tcase_add_test(tc_core, check_canreader_asc);
+  tcase_add_test(tc_core, check_canreader_blf);
+  tcase_add_test(tc_core, check_canreader_clg);
+  tcase_add_test(tc_core, check_canreader_vsb);
+  tcase_add_test(tc_core, check_canreader_stdin);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  s = test_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,246 @@
+/*  check_textscan.c --  test text trace scanning kernels
+    Copyright (C) 2026 Andreas Heitmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "cantools_config.h"
+
+/* Check unit test tool header */
+#include <check.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "textscan.h"
+
+/* characters of generated text, mostly well-formed hex pairs */
+static const char textChars[] = "0123456789abcdefABCDEF  gG.\r\n\x80\xff";
+
+/* pseudo random numbers, reproducible across platforms */
+static unsigned int rand_next(unsigned int *state)
+{
+  *state = *state * 1103515245u + 12345u;
+  return (*state >> 16) & 0x7FFF;
+}
+
+/* generate a run of hex pairs, occasionally disturbed */
+static size_t text_hexPairs(char *text, size_t size, unsigned int *state)
+{
+  size_t len = rand_next(state) % size;
+  size_t i;
+
+  for(i = 0; i < len; i++) {
+    static const char hex[] = "0123456789abcdefABCDEF";
+
+    if((i % 3) == 2) {
+      text[i] = ' ';
+    } else {
+      text[i] = hex[rand_next(state) % (sizeof(hex) - 1)];
+    }
+    if((rand_next(state) % 64) == 0) {
+      text[i] = textChars[rand_next(state) % (sizeof(textChars) - 1)];
+    }
+  }
+  return len;
+}
+
+/*
+ * vector kernels against the scalar kernel:
+ * text length and start offset, number of requested pairs
+ */
+START_TEST(check_textscan_hexpairs)
+{
+  textScanLevel_t level;
+  unsigned int state = 1;
+  int iteration;
+
+  for(level = textScan_sse2; level <= textScan_avx2; level++) {
+    if(textScan_setLevel(level) != level) continue;
+
+    for(iteration = 0; iteration < 200000; iteration++) {
+      char text[256];
+      uint8 expected[80], result[80];
+      const char *expectedNext, *resultNext;
+      size_t len = text_hexPairs(text, sizeof(text), &state);
+      size_t offset = (len > 0) ? rand_next(&state) % (len + 1) : 0;
+      unsigned int max = rand_next(&state) % 80;
+      unsigned int n, nExpected;
+
+      /* the kernel must not read beyond the end of text */
+      char *copy = malloc(len - offset + 1);
+      ck_assert(copy != NULL);
+      memcpy(copy, text + offset, len - offset);
+
+      nExpected = textScan_hexPairsScalar(copy, copy + len - offset,
+                                          expected, max, &expectedNext);
+      n = textScan_hexPairs(copy, copy + len - offset,
+                            result, max, &resultNext);
+      ck_assert(n == nExpected);
+      ck_assert(resultNext == expectedNext);
+      ck_assert(!memcmp(result, expected, n));
+      free(copy);
+    }
+  }
+  textScan_setLevel(textScan_avx2);
+}
+END_TEST
+
+START_TEST(check_textscan_hexpairs_values)
+{
+  static const char text[] = "00 1a FF 7f 80 Ab cD 09 90 fe 01 23 45 "
+                             "67 89 ab cd ef 10 99 0x 12 ";
+  static const uint8 expected[] = {
+    0x00, 0x1a, 0xff, 0x7f, 0x80, 0xab, 0xcd, 0x09, 0x90, 0xfe,
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x10, 0x99
+  };
+  textScanLevel_t level;
+
+  for(level = textScan_scalar; level <= textScan_avx2; level++) {
+    uint8 result[32];
+    const char *next;
+
+    if(textScan_setLevel(level) != level) continue;
+    ck_assert(textScan_hexPairs(text, text + sizeof(text) - 1,
+                                result, 32, &next) == 20);
+    ck_assert(next == text + 60);
+    ck_assert(!memcmp(result, expected, sizeof(expected)));
+  }
+  textScan_setLevel(textScan_avx2);
+}
+END_TEST
+
+/*
+ * time stamps: integer part with 1-12 digits, 0-11 decimal places,
+ * terminated by blank or end of text
+ */
+START_TEST(check_textscan_time)
+{
+  textScanLevel_t level;
+  unsigned int state = 1;
+  int iteration;
+
+  for(level = textScan_scalar; level <= textScan_avx2; level++) {
+    if(textScan_setLevel(level) != level) continue;
+
+    for(iteration = 0; iteration < 100000; iteration++) {
+      char text[64];
+      size_t len = 0;
+      unsigned int nInt = 1 + rand_next(&state) % 12;
+      unsigned int nFrac = rand_next(&state) % 12;
+      uint64_t sec, expectedSec = 0;
+      uint32 nsec, expectedNsec = 0;
+      unsigned int i;
+      char *copy;
+      int ret;
+
+      for(i = 0; i < nInt; i++) text[len++] = '0' + rand_next(&state) % 10;
+      if((rand_next(&state) % 16) != 0) text[len++] = '.';
+      for(i = 0; i < nFrac; i++) text[len++] = '0' + rand_next(&state) % 10;
+      if((rand_next(&state) % 8) != 0) {
+        while(len < 40) text[len++] = ' ';
+      }
+
+      copy = malloc(len + 1);
+      ck_assert(copy != NULL);
+      memcpy(copy, text, len);
+      ret = textScan_timeScalar(copy, copy + len, &expectedSec,
+                                &expectedNsec);
+      ck_assert(textScan_time(copy, copy + len, &sec, &nsec) == ret);
+      if(ret == 0) {
+        ck_assert(sec == expectedSec);
+        ck_assert(nsec == expectedNsec);
+      }
+      free(copy);
+    }
+  }
+  textScan_setLevel(textScan_avx2);
+}
+END_TEST
+
+START_TEST(check_textscan_time_values)
+{
+  static const struct {
+    const char *text;
+    int        ret;
+    uint64_t   sec;
+    uint32     nsec;
+  } cases[] = {
+    { "0.000000 1 ",          0, 0,        0         },
+    { "12.345678 1",          0, 12,       345678000 },
+    { "1234567.1 ",           0, 1234567,  100000000 },
+    { "1.123456789123 ",      0, 1,        123456789 },
+    { "98765432.5",           0, 98765432, 500000000 },
+    { "7. ",                  0, 7,        0         },
+    { ".5 ",                 -1, 0,        0         },
+    { "12 Rx ",              -1, 0,        0         }
+  };
+  textScanLevel_t level;
+  unsigned int i;
+
+  for(level = textScan_scalar; level <= textScan_avx2; level++) {
+    if(textScan_setLevel(level) != level) continue;
+    for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+      char text[64];
+      uint64_t sec;
+      uint32 nsec;
+
+      /* time stamps within lines and at end of text */
+      memset(text, ' ', sizeof(text));
+      memcpy(text, cases[i].text, strlen(cases[i].text));
+      ck_assert(textScan_time(text, text + sizeof(text),
+                              &sec, &nsec) == cases[i].ret);
+      if(cases[i].ret == 0) {
+        ck_assert(sec == cases[i].sec);
+        ck_assert(nsec == cases[i].nsec);
+      }
+      ck_assert(textScan_time(cases[i].text,
+                              cases[i].text + strlen(cases[i].text),
+                              &sec, &nsec) == cases[i].ret);
+    }
+  }
+  textScan_setLevel(textScan_avx2);
+}
+END_TEST
+
+Suite * test_suite(void)
+{
+  Suite *s;
+  TCase *tc_core;
+
+  s = suite_create("cantools");
+  tc_core = tcase_create("Core");
+  tcase_set_timeout(tc_core, 60);
+  tcase_add_test(tc_core, check_textscan_hexpairs);
+  tcase_add_test(tc_core, check_textscan_hexpairs_values);
+  tcase_add_test(tc_core, check_textscan_time);
+  tcase_add_test(tc_core, check_textscan_time_values);
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int main(void)
+{
+  int number_failed;
+  Suite *s;
+  SRunner *sr;
+
+  s = test_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+  return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}